@@ -0,0 +1,165 @@
+#ifndef ARTIFACT_BUNDLE_H
+#define ARTIFACT_BUNDLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Diagnostics.h"
+#include "Node.h"
+#include "SymbolTable.h"
+#include "TraceBuffer.h"
+
+// Single-file binary bundle of tree.json, trace.json and symbol_table.json
+// (artifacts.bundle), laid out so readers can map it and use the arrays in
+// place:
+//
+//   header     BundleHeader
+//   directory  one BundleSection per section
+//   sections   each 8-byte aligned: string index, string bytes, nodes,
+//              events, symbols
+//
+// Every name in the bundle is an index into the shared string table.
+// Nodes are stored in preorder, so a node's index is its id, its first
+// child is the next node and each further child follows the previous
+// child's subtree. Events use the TraceEvent layout with `name` pointing
+// into the string table. Integers are in the writer's byte order; the
+// header's byteOrder field lets readers reject a foreign one.
+constexpr char kBundleMagic[8] = {'A', 'R', 'T', 'B', 'N', 'D', 'L', '1'};
+constexpr uint32_t kBundleVersion = 2;   // 2: events carry their VM step
+constexpr uint32_t kBundleByteOrder = 0x01020304;
+
+// BundleHeader::flags: how the JSON files were written, so the converter
+// reproduces them
+enum BundleFlags : uint32_t {
+    kBundleSpans = 1 << 0,          // tree.json has "span"
+    kBundleCompactTree = 1 << 1,    // tree.json is not indented
+    kBundleValues = 1 << 2,         // trace.json has "value"
+    kBundleDictionaryTree = 1 << 3  // tree.json uses the dictionary schema
+};
+
+enum class BundleSectionKind : uint32_t {
+    StringIndex,
+    StringBytes,
+    Nodes,
+    Events,
+    Symbols
+};
+
+struct BundleHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t sectionCount;
+    uint32_t byteOrder;
+    uint64_t fileSize;
+};
+
+struct BundleSection {
+    BundleSectionKind kind;
+    uint32_t elementSize;
+    uint64_t offset;        // from the start of the file
+    uint64_t count;         // elements (bytes for StringBytes)
+};
+
+struct BundleString {
+    uint32_t offset;        // into the string bytes section
+    uint32_t length;
+};
+
+struct BundleNode {
+    uint32_t label;
+    uint32_t parent;        // kNoNode for the root
+    uint32_t childCount;
+    uint32_t subtreeSize;   // this node and all its descendants
+    uint32_t offset;        // source span, as in Node
+    uint32_t length;
+};
+
+struct BundleSymbol {
+    uint32_t name;
+    uint32_t type;
+    uint32_t scope;
+    int32_t value;
+    uint8_t hasValue;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(BundleHeader) == 32, "bundle records have a fixed layout");
+static_assert(sizeof(BundleSection) == 24, "bundle records have a fixed layout");
+static_assert(sizeof(BundleNode) == 24, "bundle records have a fixed layout");
+static_assert(sizeof(BundleSymbol) == 20, "bundle records have a fixed layout");
+
+// Writes the parse tree, the retained trace events and the symbol table.
+bool writeArtifactBundle(const std::string& path, const Node& tree, const TraceBuffer& trace,
+                         const std::vector<SymbolEntry>& symbols, uint32_t flags);
+
+// View of a fixed-size record array inside the mapping
+template <typename T>
+struct BundleArray {
+    const T* data = nullptr;
+    size_t count = 0;
+
+    size_t size() const { return count; }
+    const T& operator[](size_t i) const { return data[i]; }
+    const T* begin() const { return data; }
+    const T* end() const { return data + count; }
+};
+
+// Read-only mapping of a bundle. openArtifactBundle() checks the header
+// and that every index stays in bounds; after that all accessors are
+// plain pointer reads.
+class ArtifactBundle {
+public:
+    ArtifactBundle() = default;
+    ArtifactBundle(ArtifactBundle&& other) noexcept;
+    ArtifactBundle& operator=(ArtifactBundle&& other) noexcept;
+    ~ArtifactBundle();
+
+    ArtifactBundle(const ArtifactBundle&) = delete;
+    ArtifactBundle& operator=(const ArtifactBundle&) = delete;
+
+    uint32_t flags() const { return header().flags; }
+    size_t stringCount() const { return stringIndex.size(); }
+    std::string_view string(uint32_t id) const {
+        return std::string_view(stringBytes + stringIndex[id].offset, stringIndex[id].length);
+    }
+
+    BundleArray<BundleNode> nodes() const { return nodeArray; }
+    BundleArray<TraceEvent> events() const { return eventArray; }
+    BundleArray<BundleSymbol> symbols() const { return symbolArray; }
+
+    // Children of node `id` in order: first is id + 1, the next one starts
+    // after the previous child's subtree.
+    uint32_t nextSibling(uint32_t id) const { return id + nodeArray[id].subtreeSize; }
+
+private:
+    const char* base = nullptr;
+    size_t mappedSize = 0;
+    BundleArray<BundleString> stringIndex;
+    const char* stringBytes = nullptr;
+    BundleArray<BundleNode> nodeArray;
+    BundleArray<TraceEvent> eventArray;
+    BundleArray<BundleSymbol> symbolArray;
+
+    const BundleHeader& header() const { return *reinterpret_cast<const BundleHeader*>(base); }
+    void unmap();
+
+    friend Result<ArtifactBundle> openArtifactBundle(const std::string& path);
+};
+
+Result<ArtifactBundle> openArtifactBundle(const std::string& path);
+
+// Converters back to the in-memory forms the JSON writers take
+Node bundleToTree(const ArtifactBundle& bundle);
+void bundleToTrace(const ArtifactBundle& bundle, TraceBuffer& buffer);
+std::vector<SymbolEntry> bundleToSymbols(const ArtifactBundle& bundle);
+
+// --unbundle: writes tree.json, trace.json and symbol_table.json from a
+// bundle, as the run that wrote it would have; `atomic` as --atomic-writes.
+// Returns 0, or 1 on errors.
+int runUnbundle(const std::string& path, std::ostream& out, bool atomic = false);
+
+#endif // ARTIFACT_BUNDLE_H
@@ -0,0 +1,68 @@
+#ifndef ARTIFACT_WRITER_H
+#define ARTIFACT_WRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes output files concurrently so the run does not wait for each one
+// in turn. Two kinds of jobs are queued:
+//
+//   produce()  a writer that serializes straight to a file path (the
+//              streaming tree writer, say); runs on a worker thread
+//   write()    bytes already in memory; written by a worker thread
+//
+// Both write their files through AsyncFile (BufferedSink for the streaming
+// writers), which queues the data to a per-thread io_uring where the kernel
+// supports it and falls back to pwrite() on the worker otherwise.
+//
+// With atomic set, each file is written to "<path>.tmp" and renamed over
+// <path> once complete, so readers never see a partial artifact. wait()
+// blocks until every queued job has finished.
+class ArtifactWriter {
+public:
+    using Producer = std::function<bool(const std::string& path)>;
+
+    explicit ArtifactWriter(bool atomic = false, unsigned threads = 2);
+    ~ArtifactWriter();
+
+    ArtifactWriter(const ArtifactWriter&) = delete;
+    ArtifactWriter& operator=(const ArtifactWriter&) = delete;
+
+    void produce(const std::string& path, Producer producer);
+    void write(const std::string& path, std::string contents);
+
+    // Runs `job` on a worker with no temp file, for writers that manage
+    // their own (possibly several) output files.
+    void run(std::function<bool()> job, const std::string& description);
+
+    // Waits for all jobs; returns false if any failed (see failures()).
+    bool wait();
+    const std::vector<std::string>& failures() const { return failed; }
+
+    // "io_uring" or "threads"
+    const char* backend() const;
+
+private:
+    bool atomic;
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;
+    std::mutex mutex;
+    std::condition_variable available;
+    std::condition_variable idle;
+    size_t pending = 0;
+    bool stopping = false;
+    std::vector<std::string> failed;
+
+    std::string stagingPath(const std::string& path) const;
+    bool commit(const std::string& staged, const std::string& path);
+    void enqueue(std::function<void()> job);
+    void fail(const std::string& message);
+    void workerLoop();
+};
+
+#endif // ARTIFACT_WRITER_H
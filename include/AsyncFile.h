@@ -0,0 +1,75 @@
+#ifndef ASYNC_FILE_H
+#define ASYNC_FILE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class IoRing;
+
+// Output file whose writes go through io_uring where the kernel has it:
+// write() queues a buffer and returns, so the caller fills the next buffer
+// while the kernel writes the previous one. Each thread submits to its own
+// ring. Without io_uring (an old kernel, a seccomp filter, or
+// setIoUringEnabled(false)) writes are plain pwrite() calls on the calling
+// thread, usually one of ArtifactWriter's workers.
+//
+// With `atomic` the data goes to "<path>.tmp", which close() renames over
+// <path> once everything is written; a file that fails, or is destroyed
+// without close(), leaves <path> untouched.
+//
+// A file keeps the ring of the thread that first queued to it, so it may
+// be handed to another thread (a streamed trace is finished on a worker).
+// A queued buffer stays owned by the file until its write completes; a
+// short write is resubmitted for the remainder at the following offset.
+class AsyncFile {
+public:
+    explicit AsyncFile(const std::string& path, bool atomic = false);
+    ~AsyncFile();
+
+    AsyncFile(const AsyncFile&) = delete;
+    AsyncFile& operator=(const AsyncFile&) = delete;
+
+    bool ok() const { return !failed; }
+
+    // Writes buffer[0, size). When the write is queued, `buffer` is swapped
+    // for a spare of the same capacity, so the caller can keep filling it.
+    void write(std::string& buffer, size_t size);
+    // Writes `bytes`, taking ownership while they are queued.
+    void write(std::string bytes);
+
+    // Waits for the queued writes, closes the file and, if atomic, renames
+    // it into place; returns ok().
+    bool close();
+
+private:
+    struct Pending;
+    friend class IoRing;
+
+    std::string path;
+    std::string staged;         // path, or "<path>.tmp" when atomic
+    int fd;
+    std::atomic<bool> failed{false};
+    uint64_t offset = 0;        // where the next write goes
+    std::shared_ptr<IoRing> ring;
+    // Guarded by the ring's mutex, as completions may be reaped by any
+    // thread using the ring
+    unsigned queued = 0;        // writes submitted and not yet completed
+    std::vector<std::string> spares;
+
+    // Hands bytes[0, size) to the ring, leaving `bytes` empty or, with
+    // `reuse`, holding a spare buffer if there is one; false (and `bytes`
+    // untouched) without a usable ring
+    bool queue(std::string& bytes, size_t size, bool reuse);
+    void writeNow(const char* data, size_t size);
+};
+
+// Whether new writes may use io_uring: the kernel supports it (probed once)
+// and it was not disabled.
+bool ioUringAvailable();
+// --no-io-uring, and tests forcing the pwrite() path.
+void setIoUringEnabled(bool enabled);
+
+#endif // ASYNC_FILE_H
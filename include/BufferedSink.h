@@ -0,0 +1,99 @@
+#ifndef BUFFERED_SINK_H
+#define BUFFERED_SINK_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "AsyncFile.h"
+
+// Output file with a large user-space buffer, for writers that emit many
+// small pieces of text. Full buffers are handed to an AsyncFile, so with
+// io_uring the writer fills the next buffer while the last one is written.
+// An atomic sink (see AsyncFile) only replaces `path` when close() is called
+// and everything was written; destroying it unclosed discards the output.
+class BufferedSink {
+public:
+    explicit BufferedSink(const std::string& path, bool atomic = false, size_t capacity = 1 << 16);
+    ~BufferedSink();
+
+    BufferedSink(const BufferedSink&) = delete;
+    BufferedSink& operator=(const BufferedSink&) = delete;
+
+    bool ok() const { return file.ok(); }
+    uint64_t bytesWritten() const { return flushed + used; }
+
+    void write(std::string_view text) {
+        if (used + text.size() > buffer.size())
+            drain(text);
+        else {
+            text.copy(&buffer[used], text.size());
+            used += text.size();
+        }
+    }
+
+    void put(char c) {
+        if (used == buffer.size())
+            flush();
+        buffer[used++] = c;
+    }
+
+    // Writes `text` as a JSON string literal, escaped the way nlohmann::json
+    // dumps it.
+    void writeJsonString(std::string_view text);
+
+    void flush();
+    void close();
+
+private:
+    AsyncFile file;
+    std::string buffer;
+    size_t used = 0;
+    uint64_t flushed = 0;
+
+    void drain(std::string_view text);
+};
+
+// In-memory counterpart of BufferedSink, for text built off the writing
+// thread and copied into a file sink later.
+class StringSink {
+public:
+    std::string text;
+
+    void write(std::string_view s) { text.append(s.data(), s.size()); }
+    void put(char c) { text.push_back(c); }
+    void writeJsonString(std::string_view s);
+};
+
+// Writes `text` as a JSON string literal into any sink with write() and
+// put(), escaped the way nlohmann::json dumps it. Unescaped runs are
+// copied in one write.
+template <typename Sink>
+void writeJsonStringTo(Sink& sink, std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    sink.put('"');
+    size_t runStart = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        sink.write(text.substr(runStart, i - runStart));
+        runStart = i + 1;
+        switch (c) {
+        case '"': sink.write("\\\""); break;
+        case '\\': sink.write("\\\\"); break;
+        case '\b': sink.write("\\b"); break;
+        case '\f': sink.write("\\f"); break;
+        case '\n': sink.write("\\n"); break;
+        case '\r': sink.write("\\r"); break;
+        case '\t': sink.write("\\t"); break;
+        default: {
+            char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+            sink.write(std::string_view(escaped, sizeof(escaped)));
+        }
+        }
+    }
+    sink.write(text.substr(runStart));
+    sink.put('"');
+}
+
+#endif // BUFFERED_SINK_H
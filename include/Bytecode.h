@@ -0,0 +1,89 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Node.h"
+#include "TraceEvent.h"
+
+// Opcodes of the simulator's stack machine. Kept as an X-macro so the VM's
+// computed-goto dispatch table stays in sync with the enum.
+#define BYTECODE_OPS(X) \
+    X(PushConst)        \
+    X(Load)             \
+    X(Store)            \
+    X(Pop)              \
+    X(Add)              \
+    X(Sub)              \
+    X(Mul)              \
+    X(Div)              \
+    X(Mod)              \
+    X(Eq)               \
+    X(Ne)               \
+    X(Lt)               \
+    X(Gt)               \
+    X(Le)               \
+    X(Ge)               \
+    X(Jump)             \
+    X(JumpIfFalse)      \
+    X(LoopEnter)        \
+    X(LoopCheck)        \
+    X(LoopNext)         \
+    X(LoopExit)         \
+    X(CinDefault)       \
+    X(Call)             \
+    X(Ret)              \
+    X(Trace)            \
+    X(Halt)
+
+enum class OpCode : uint8_t {
+#define BYTECODE_ENUM(name) name,
+    BYTECODE_OPS(BYTECODE_ENUM)
+#undef BYTECODE_ENUM
+};
+
+// Operand use by opcode:
+//   PushConst a=value            Load/Store/CinDefault a=frame slot
+//   Jump/JumpIfFalse/LoopCheck a=target
+//   Call a=function index, b=argument count (arguments are on the stack)
+//   Trace a=name id, flag=TraceAction, b=branch (1 = then), node=source node id
+struct Instruction {
+    OpCode op;
+    uint8_t flag;
+    uint32_t a;
+    uint32_t b;
+    uint32_t node;
+};
+
+// Every parameter and local of a function is resolved to a fixed slot in
+// its frame; parameters occupy the first paramCount slots.
+struct BytecodeFunction {
+    uint32_t nameId;
+    uint32_t entry;
+    uint32_t paramCount;
+    std::vector<uint32_t> slotNames;    // slot -> name id
+
+    uint32_t slotCount() const { return static_cast<uint32_t>(slotNames.size()); }
+};
+
+struct BytecodeProgram {
+    std::vector<Instruction> code;
+    std::vector<BytecodeFunction> functions;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> nameIds;
+    std::unordered_map<const Node*, uint32_t> functionIndex;
+
+    uint32_t intern(const std::string& name);
+};
+
+// Lowers every function in `functions` and returns the program. Calls are
+// resolved to the first function with a matching name, as before.
+BytecodeProgram compileProgram(const std::vector<Node>& functions);
+
+// Compiles `node` as a statement into a parameterless entry function that
+// ends in Halt, and returns its function index.
+uint32_t compileEntry(BytecodeProgram& program, const Node& node);
+
+#endif // BYTECODE_H
@@ -0,0 +1,86 @@
+#ifndef COLUMNAR_TRACE_H
+#define COLUMNAR_TRACE_H
+
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "Diagnostics.h"
+#include "TraceBuffer.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// Columnar trace file (trace.columns), for tools that aggregate many
+// traces and only need a few fields of each.
+//
+//   header     "TRCOLS1\0", u32 column count, u64 event count
+//   directory  per column: name (12 bytes, NUL padded), u8 encoding,
+//              3 bytes padding, u64 offset, u64 size
+//   strings    u32 count, then LEB128 length + bytes per string
+//   columns    one encoded block per column
+//
+// Every column holds an unsigned integer per event. step is the number of
+// VM instructions executed when the event was recorded (u64); the others
+// fit in a u32. Name columns hold string table id + 1 (0 = none); branch
+// holds 1 = else, 2 = then (0 = none); value holds the zigzag-coded value
+// of vardecl / assign events (0 otherwise) and is only present in traces
+// written with --trace-values; node holds the parse-tree node id + 1
+// (0 = none). Each column is stored with whichever encoding is smallest for it: plain LEB128,
+// zigzag deltas, or (value, run length) pairs. All integers are little
+// endian.
+enum class ColumnEncoding : uint8_t {
+    Plain,
+    Delta,
+    RunLength
+};
+
+// Column names, in file order
+inline const char* const kTraceColumns[] = {"step", "action", "function", "variable", "branch", "limit", "value", "node"};
+
+// Collects columns while TraceWriter writes events.
+class ColumnarTraceBuilder {
+public:
+    void add(const TraceEvent& event);
+
+    // Leaves the value column out unless `values` is set; `atomic` stages
+    // the file as <path>.tmp
+    bool write(const std::string& path, const StringPool& names, bool values, bool atomic = false) const;
+
+private:
+    std::vector<uint64_t> columns[std::size(kTraceColumns)];
+};
+
+class ColumnarTrace {
+public:
+    uint64_t size() const { return events; }
+    const std::vector<std::string>& strings() const { return table; }
+    std::vector<std::string> columnNames() const;
+    bool hasColumn(const std::string& name) const;
+
+    // Reads and decodes only the named column.
+    Result<std::vector<uint64_t>> column(const std::string& name) const;
+
+private:
+    struct Column {
+        std::string name;
+        ColumnEncoding encoding;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    std::string path;
+    uint64_t events = 0;
+    std::vector<Column> directory;
+    std::vector<std::string> table;
+
+    friend Result<ColumnarTrace> openColumnarTrace(const std::string& path);
+};
+
+Result<ColumnarTrace> openColumnarTrace(const std::string& path);
+
+// Rebuilds the trace.json events from the columns (see traceEventToJson),
+// with "value" when the trace has a value column
+Result<json> columnarTraceToJson(const ColumnarTrace& trace);
+
+#endif // COLUMNAR_TRACE_H
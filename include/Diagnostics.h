@@ -0,0 +1,22 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <string>
+#include <vector>
+
+struct Diagnostic {
+    std::string message;
+    int line = 0;
+    int column = 0;
+};
+
+// Result channel used by the tokenizer and parser instead of exceptions.
+template <typename T>
+struct Result {
+    T value;
+    std::vector<Diagnostic> diagnostics;
+
+    bool ok() const { return diagnostics.empty(); }
+};
+
+#endif // DIAGNOSTICS_H
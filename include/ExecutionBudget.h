@@ -0,0 +1,25 @@
+#ifndef EXECUTION_BUDGET_H
+#define EXECUTION_BUDGET_H
+
+#include <cstdint>
+
+// Limits on one simulation run. A limit of 0 disables that check.
+struct ExecutionBudget {
+    uint64_t maxSteps = 1000000;        // VM instructions executed
+    uint32_t maxCallDepth = 256;        // nested frames
+    uint64_t maxTraceEvents = 10000;    // events recorded by this run
+    uint32_t timeLimitMs = 0;           // wall-clock deadline
+    uint32_t maxLoopIterations = 100000; // per loop entry; the loop then exits
+};
+
+enum class ExecutionStatus {
+    Completed,
+    StepLimit,
+    CallDepthLimit,
+    TraceEventLimit,
+    TimeLimit
+};
+
+const char* executionStatusName(ExecutionStatus status);
+
+#endif // EXECUTION_BUDGET_H
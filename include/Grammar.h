@@ -0,0 +1,453 @@
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include "Language.h"
+
+// A frontend's syntax as text, compiled into LL(1) parse tables by
+// buildGrammar() at build time (see src/languages/CppSubset.cpp). Each rule
+// names a nonterminal and its alternatives:
+//
+//   Name -> alternative | alternative | * alternative
+//
+// An alternative is a sequence of
+//   'text'         a literal token, matched by value
+//   IDENT TYPE BINOP PREPROCESSOR
+//                  identifiers, the spec's type names and binary operators,
+//                  preprocessor lines. A literal word that is not a keyword
+//                  ('using', say) is an identifier too, so IDENT matches it.
+//   ANY            any one token
+//   Name           a nonterminal
+//   {action}       a semantic action run at that point
+// and ends with an optional `=> action`, run once the alternative is
+// complete. `~` is the empty alternative. A terminal may be followed by
+// "message", the diagnostic when it is missing.
+//
+// Alternatives are chosen on the next token. `*` marks the default, taken
+// on every token no other alternative can start with; `* "message"` makes
+// those tokens an error instead. A rule with a single alternative uses it
+// as the default. In a message `$` stands for the first token of the
+// statement (see below) being parsed, and the error is reported there.
+//
+// `Name [statement]` or `Name [function]` declares a recovery list, one
+// alternative of which is `Element Name`. An error abandons the innermost
+// element being parsed, which becomes an error node; what encloses it is
+// parsed on with further errors suppressed, and the list skips to the next
+// statement or function before its next element (see Parser.cpp).
+// Elements are what `$` refers to.
+
+enum TerminalId : uint8_t {
+    T_Eof,
+    T_Ident,
+    T_Type,
+    T_BinOp,
+    T_Preprocessor,
+    T_Other,            // a token none of the grammar's terminals match
+    T_FirstLiteral
+};
+
+inline constexpr size_t kMaxTerminals = 64;     // terminal sets are uint64_t
+inline constexpr size_t kMaxNonterminals = 64;
+inline constexpr size_t kMaxProductions = 128;
+inline constexpr size_t kMaxRhs = 12;
+inline constexpr uint8_t kAnyToken = 0xFF;      // GrammarSymbol::id of ANY
+inline constexpr uint8_t kErrorEntry = 0xFF;    // parse table: the nonterminal's error default
+
+enum class SymbolKind : uint8_t {
+    Terminal,
+    Nonterminal,
+    Action
+};
+
+enum class Recovery : uint8_t {
+    None,
+    Statement,
+    Function
+};
+
+struct NamedAction {
+    std::string_view name;
+    SemanticAction action;
+};
+
+struct GrammarSymbol {
+    SymbolKind kind = SymbolKind::Terminal;
+    uint8_t id = 0;
+    std::string_view message;           // terminals: diagnostic when missing
+    SemanticAction action = nullptr;    // mid-rule actions
+};
+
+struct Production {
+    uint8_t lhs = 0;
+    uint8_t size = 0;
+    uint8_t values = 0;                 // symbols other than mid-rule actions
+    SemanticAction action = nullptr;    // null: pass the only value through
+    GrammarSymbol symbols[kMaxRhs] = {};
+};
+
+constexpr uint64_t terminalBit(size_t terminal) {
+    return uint64_t(1) << terminal;
+}
+
+struct Grammar {
+    std::string_view literals[kMaxTerminals] = {};      // by terminal id, from T_FirstLiteral
+    size_t terminalCount = T_FirstLiteral;
+    std::string_view names[kMaxNonterminals] = {};
+    std::string_view errors[kMaxNonterminals] = {};     // message of a `* "..."` default
+    Recovery recovery[kMaxNonterminals] = {};
+    bool element[kMaxNonterminals] = {};                // the element of some recovery list
+    uint64_t stops[kMaxNonterminals] = {};              // recovery lists: tokens a skip stops before
+    uint64_t identifiers = terminalBit(T_Ident);        // terminals IDENT matches
+    size_t nonterminalCount = 0;
+    Production productions[kMaxProductions] = {};
+    size_t productionCount = 0;
+    uint8_t table[kMaxNonterminals][kMaxTerminals] = {};
+
+    constexpr uint8_t literal(std::string_view value) const {
+        for (size_t t = T_FirstLiteral; t < terminalCount; ++t)
+            if (literals[t] == value)
+                return static_cast<uint8_t>(t);
+        return T_Other;
+    }
+};
+
+namespace grammar_detail {
+
+constexpr bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+constexpr bool isNameChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+struct Cursor {
+    std::string_view text;
+    size_t pos = 0;
+
+    constexpr void skipSpace() {
+        while (pos < text.size()) {
+            if (isSpace(text[pos]))
+                ++pos;
+            else if (text[pos] == '/' && pos + 1 < text.size() && text[pos + 1] == '/')
+                while (pos < text.size() && text[pos] != '\n')
+                    ++pos;
+            else
+                break;
+        }
+    }
+    constexpr bool atEnd() {
+        skipSpace();
+        return pos >= text.size();
+    }
+    constexpr bool at(std::string_view s) {
+        skipSpace();
+        return text.substr(pos, s.size()) == s;
+    }
+    constexpr bool take(std::string_view s) {
+        if (!at(s))
+            return false;
+        pos += s.size();
+        return true;
+    }
+    constexpr std::string_view name() {
+        skipSpace();
+        size_t start = pos;
+        while (pos < text.size() && isNameChar(text[pos]))
+            ++pos;
+        if (pos == start)
+            throw std::invalid_argument("grammar: expected a name");
+        return text.substr(start, pos - start);
+    }
+    constexpr std::string_view quoted(char quote) {
+        size_t start = ++pos;
+        while (pos < text.size() && text[pos] != quote)
+            ++pos;
+        if (pos >= text.size())
+            throw std::invalid_argument("grammar: unterminated quote");
+        return text.substr(start, pos++ - start);
+    }
+    // Whether a new rule starts here: a name followed by '->' or '['
+    constexpr bool atRule() {
+        Cursor next = *this;
+        if (next.atEnd() || !isNameChar(next.text[next.pos]))
+            return false;
+        next.name();
+        return next.at("->") || next.at("[");
+    }
+};
+
+constexpr SemanticAction findAction(std::string_view name, const NamedAction* actions, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        if (actions[i].name == name)
+            return actions[i].action;
+    throw std::invalid_argument("grammar: unknown action");
+}
+
+constexpr uint8_t nonterminal(Grammar& g, std::string_view name) {
+    for (size_t i = 0; i < g.nonterminalCount; ++i)
+        if (g.names[i] == name)
+            return static_cast<uint8_t>(i);
+    if (g.nonterminalCount == kMaxNonterminals)
+        throw std::invalid_argument("grammar: too many nonterminals");
+    g.names[g.nonterminalCount] = name;
+    return static_cast<uint8_t>(g.nonterminalCount++);
+}
+
+constexpr uint8_t terminal(Grammar& g, std::string_view literal) {
+    uint8_t t = g.literal(literal);
+    if (t != T_Other)
+        return t;
+    if (g.terminalCount == kMaxTerminals)
+        throw std::invalid_argument("grammar: too many terminals");
+    g.literals[g.terminalCount] = literal;
+    return static_cast<uint8_t>(g.terminalCount++);
+}
+
+// FIRST of symbols[from, size) of `p`; `nullable` says whether they can
+// all derive the empty string
+constexpr uint64_t firstOf(const Grammar& g, const Production& p, size_t from, const uint64_t* first,
+                           const bool* nullables, uint64_t any, bool& nullable) {
+    uint64_t set = 0;
+    for (size_t i = from; i < p.size; ++i) {
+        const GrammarSymbol& s = p.symbols[i];
+        if (s.kind == SymbolKind::Action)
+            continue;
+        if (s.kind == SymbolKind::Terminal) {
+            nullable = false;
+            if (s.id == kAnyToken)
+                return set | any;
+            return set | (s.id == T_Ident ? g.identifiers : terminalBit(s.id));
+        }
+        set |= first[s.id];
+        if (!nullables[s.id]) {
+            nullable = false;
+            return set;
+        }
+    }
+    nullable = true;
+    return set;
+}
+
+} // namespace grammar_detail
+
+// Parses `text` and builds its LL(1) table. Throws std::invalid_argument
+// on a malformed grammar or when two alternatives of a rule can start with
+// the same token, which in a constant expression is a compile error.
+// `keywords` are the literals statement recovery may stop before;
+// literals may not be type names or binary operators, which have their
+// own terminals.
+constexpr Grammar buildGrammar(std::string_view text, const NamedAction* actions, size_t actionCount,
+                               WordList keywords, WordList typeNames, WordList binaryOperators) {
+    using namespace grammar_detail;
+    Grammar g;
+    Cursor in{text};
+    bool defined[kMaxNonterminals] = {};
+    int defaults[kMaxNonterminals] = {};    // production, or -1 for an error default
+    int alternatives[kMaxNonterminals] = {};
+
+    while (!in.atEnd()) {
+        uint8_t lhs = nonterminal(g, in.name());
+        if (defined[lhs])
+            throw std::invalid_argument("grammar: rule defined twice");
+        defined[lhs] = true;
+        defaults[lhs] = -2;
+        if (in.take("[")) {
+            std::string_view kind = in.name();
+            if (kind == "statement")
+                g.recovery[lhs] = Recovery::Statement;
+            else if (kind == "function")
+                g.recovery[lhs] = Recovery::Function;
+            else
+                throw std::invalid_argument("grammar: unknown recovery kind");
+            if (!in.take("]"))
+                throw std::invalid_argument("grammar: expected ]");
+        }
+        if (!in.take("->"))
+            throw std::invalid_argument("grammar: expected ->");
+
+        do {
+            bool isDefault = in.take("*");
+            ++alternatives[lhs];
+            if (isDefault && defaults[lhs] != -2)
+                throw std::invalid_argument("grammar: two default alternatives");
+            if (isDefault && in.at("\"")) {
+                g.errors[lhs] = in.quoted('"');
+                defaults[lhs] = -1;
+                continue;
+            }
+            if (g.productionCount == kMaxProductions)
+                throw std::invalid_argument("grammar: too many productions");
+            Production& p = g.productions[g.productionCount];
+            p.lhs = lhs;
+            while (!in.atEnd() && !in.at("|") && !in.at("=>") && !in.atRule()) {
+                if (in.take("~"))
+                    continue;
+                if (in.at("\"")) {
+                    if (p.size == 0 || p.symbols[p.size - 1].kind != SymbolKind::Terminal)
+                        throw std::invalid_argument("grammar: a message must follow a terminal");
+                    p.symbols[p.size - 1].message = in.quoted('"');
+                    continue;
+                }
+                if (p.size == kMaxRhs)
+                    throw std::invalid_argument("grammar: alternative too long");
+                GrammarSymbol& s = p.symbols[p.size++];
+                if (in.at("'")) {
+                    std::string_view literal = in.quoted('\'');
+                    if (typeNames.contains(literal) || binaryOperators.contains(literal))
+                        throw std::invalid_argument("grammar: literal is a type name or binary operator");
+                    s.id = terminal(g, literal);
+                }
+                else if (in.take("{")) {
+                    s.kind = SymbolKind::Action;
+                    s.action = findAction(in.name(), actions, actionCount);
+                    if (!in.take("}"))
+                        throw std::invalid_argument("grammar: expected }");
+                }
+                else {
+                    std::string_view name = in.name();
+                    if (name == "IDENT")
+                        s.id = T_Ident;
+                    else if (name == "TYPE")
+                        s.id = T_Type;
+                    else if (name == "BINOP")
+                        s.id = T_BinOp;
+                    else if (name == "PREPROCESSOR")
+                        s.id = T_Preprocessor;
+                    else if (name == "ANY")
+                        s.id = kAnyToken;
+                    else {
+                        s.kind = SymbolKind::Nonterminal;
+                        s.id = nonterminal(g, name);
+                    }
+                }
+                if (s.kind != SymbolKind::Action)
+                    ++p.values;
+            }
+            if (in.take("=>"))
+                p.action = findAction(in.name(), actions, actionCount);
+            else if (p.values > 1)
+                throw std::invalid_argument("grammar: an alternative with several symbols needs an action");
+            if (isDefault)
+                defaults[lhs] = static_cast<int>(g.productionCount);
+            ++g.productionCount;
+        } while (in.take("|"));
+    }
+
+    for (size_t nt = 0; nt < g.nonterminalCount; ++nt) {
+        if (!defined[nt])
+            throw std::invalid_argument("grammar: nonterminal without a rule");
+        if (defaults[nt] == -2) {
+            if (alternatives[nt] > 1)
+                throw std::invalid_argument("grammar: a rule with several alternatives needs a default");
+            for (size_t p = 0; p < g.productionCount; ++p)
+                if (g.productions[p].lhs == nt)
+                    defaults[nt] = static_cast<int>(p);
+        }
+    }
+
+    for (size_t t = T_FirstLiteral; t < g.terminalCount; ++t) {
+        bool word = true;
+        for (char c : g.literals[t])
+            word = word && isNameChar(c);
+        if (word && !keywords.contains(g.literals[t]))
+            g.identifiers |= terminalBit(t);
+    }
+
+    // Nullable and FIRST, then FOLLOW, to a fixed point
+    uint64_t any = (g.terminalCount == 64 ? ~uint64_t(0) : terminalBit(g.terminalCount) - 1) & ~terminalBit(T_Eof);
+    bool nullable[kMaxNonterminals] = {};
+    uint64_t first[kMaxNonterminals] = {};
+    uint64_t follow[kMaxNonterminals] = {};
+    follow[0] = terminalBit(T_Eof);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 0; i < g.productionCount; ++i) {
+            const Production& p = g.productions[i];
+            bool empty = false;
+            uint64_t set = firstOf(g, p, 0, first, nullable, any, empty);
+            if ((first[p.lhs] | set) != first[p.lhs] || (empty && !nullable[p.lhs])) {
+                first[p.lhs] |= set;
+                nullable[p.lhs] = nullable[p.lhs] || empty;
+                changed = true;
+            }
+        }
+    }
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 0; i < g.productionCount; ++i) {
+            const Production& p = g.productions[i];
+            for (size_t k = 0; k < p.size; ++k) {
+                if (p.symbols[k].kind != SymbolKind::Nonterminal)
+                    continue;
+                bool empty = false;
+                uint64_t set = firstOf(g, p, k + 1, first, nullable, any, empty);
+                if (empty)
+                    set |= follow[p.lhs];
+                uint8_t nt = p.symbols[k].id;
+                if ((follow[nt] | set) != follow[nt]) {
+                    follow[nt] |= set;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // The default takes every token the other alternatives do not start with
+    for (size_t nt = 0; nt < g.nonterminalCount; ++nt) {
+        uint8_t fallback = defaults[nt] < 0 ? kErrorEntry : static_cast<uint8_t>(defaults[nt]);
+        uint64_t claimed = 0;
+        for (size_t t = 0; t < g.terminalCount; ++t)
+            g.table[nt][t] = fallback;
+        for (size_t i = 0; i < g.productionCount; ++i) {
+            const Production& p = g.productions[i];
+            if (p.lhs != nt || static_cast<int>(i) == defaults[nt])
+                continue;
+            bool empty = false;
+            uint64_t set = firstOf(g, p, 0, first, nullable, any, empty);
+            if (empty)
+                set |= follow[nt];
+            if (set & claimed)
+                throw std::invalid_argument("grammar: alternatives start with the same token (not LL(1))");
+            claimed |= set;
+            for (size_t t = 0; t < g.terminalCount; ++t)
+                if (set & terminalBit(t))
+                    g.table[nt][t] = static_cast<uint8_t>(i);
+        }
+    }
+
+    // Recovery lists: a skip stops before a type name or keyword that can
+    // start the next element
+    uint64_t leads = terminalBit(T_Type);
+    for (size_t t = T_FirstLiteral; t < g.terminalCount; ++t)
+        if (keywords.contains(g.literals[t]))
+            leads |= terminalBit(t);
+    for (size_t nt = 0; nt < g.nonterminalCount; ++nt) {
+        if (g.recovery[nt] == Recovery::None)
+            continue;
+        bool found = false;
+        for (size_t i = 0; i < g.productionCount; ++i) {
+            const Production& p = g.productions[i];
+            if (p.lhs == nt && p.size == 2 && p.symbols[0].kind == SymbolKind::Nonterminal &&
+                p.symbols[1].kind == SymbolKind::Nonterminal && p.symbols[1].id == nt) {
+                g.element[p.symbols[0].id] = true;
+                g.stops[nt] = first[p.symbols[0].id] & leads;
+                found = true;
+            }
+        }
+        if (!found)
+            throw std::invalid_argument("grammar: a recovery list needs an `Element List` alternative");
+    }
+    return g;
+}
+
+template <size_t N>
+constexpr Grammar buildGrammar(std::string_view text, const NamedAction (&actions)[N], WordList keywords,
+                               WordList typeNames, WordList binaryOperators) {
+    return buildGrammar(text, actions, N, keywords, typeNames, binaryOperators);
+}
+
+#endif // GRAMMAR_H
@@ -0,0 +1,41 @@
+#ifndef HASH_CONS_H
+#define HASH_CONS_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Node.h"
+
+// Immutable DAG node produced by NodeInterner. Structurally identical
+// subtrees are represented by the same SharedNode, so pointer equality is
+// structural equality. `hash` is a stable (platform and run independent)
+// structural hash of the subtree.
+struct SharedNode {
+    std::string label;
+    std::vector<const SharedNode*> children;
+    uint64_t hash;
+    size_t index;
+};
+
+// Builds the DAG by consuming a parse tree: each subtree's Nodes are freed
+// as soon as it is interned, so the tree and the DAG are not both held in
+// full and peak memory stays near the larger of the two.
+class NodeInterner {
+private:
+    std::deque<SharedNode> nodes;
+    std::unordered_map<uint64_t, std::vector<const SharedNode*>> buckets;
+    size_t requests = 0;
+
+public:
+    const SharedNode* intern(Node&& node);
+    const std::deque<SharedNode>& uniqueNodes() const { return nodes; }
+    size_t treeNodeCount() const { return requests; }
+};
+
+// Streams the DAG to `path` as {"nodes": [...], "root": index}, formatted
+// like json::dump(4), without building a json document first.
+bool writeSharedJson(const SharedNode* root, const NodeInterner& interner, const std::string& path);
+
+#endif // HASH_CONS_H
@@ -0,0 +1,86 @@
+#ifndef LANGUAGE_H
+#define LANGUAGE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+// A language frontend (see include/languages/): the tokenizer is driven
+// entirely by these tables, the parser by the grammar's parse tables (see
+// Grammar.h), whose semantic actions build the Node tree.
+
+struct Grammar;
+struct ParseValue;
+struct ActionContext;
+
+// Builds `out` from the values of a completed alternative's symbols, or,
+// as a mid-rule action, acts on those parsed so far (see Parser.h)
+using SemanticAction = void (*)(ActionContext& context, ParseValue* rhs, ParseValue& out);
+
+enum CharClass : uint8_t {
+    CC_None = 0,
+    CC_Space = 1 << 0,
+    CC_IdentStart = 1 << 1,
+    CC_Digit = 1 << 2,
+    CC_Symbol = 1 << 3,
+    CC_Operator = 1 << 4
+};
+
+using CharClassTable = std::array<uint8_t, 256>;
+
+struct WordList {
+    const std::string_view* words;
+    size_t size;
+
+    constexpr bool contains(std::string_view word) const {
+        for (size_t i = 0; i < size; ++i)
+            if (words[i] == word)
+                return true;
+        return false;
+    }
+};
+
+struct QuotedLiteral {
+    char quote;
+    std::string_view tokenType;
+};
+
+struct LanguageSpec {
+    std::string_view name;
+    WordList keywords;
+    WordList typeNames;
+    WordList operators;          // multi-character symbols, longest first
+    WordList binaryOperators;
+    const Grammar* grammar;      // parse tables, built from the language's grammar text
+    QuotedLiteral stringLiteral;
+    QuotedLiteral charLiteral;
+    char preprocessorMarker;
+    CharClassTable charClasses;
+
+    constexpr uint8_t classOf(char c) const {
+        return charClasses[static_cast<unsigned char>(c)];
+    }
+};
+
+// Builds the lexer's character-class table at compile time.
+constexpr CharClassTable buildCharClasses(std::string_view singleSymbols, WordList operators) {
+    CharClassTable table{};
+    for (char c : std::string_view(" \t\n\v\f\r"))
+        table[static_cast<unsigned char>(c)] |= CC_Space;
+    for (int c = 'a'; c <= 'z'; ++c)
+        table[c] |= CC_IdentStart;
+    for (int c = 'A'; c <= 'Z'; ++c)
+        table[c] |= CC_IdentStart;
+    table['_'] |= CC_IdentStart;
+    for (int c = '0'; c <= '9'; ++c)
+        table[c] |= CC_Digit;
+    for (char c : singleSymbols)
+        table[static_cast<unsigned char>(c)] |= CC_Symbol;
+    for (size_t i = 0; i < operators.size; ++i)
+        table[static_cast<unsigned char>(operators.words[i][0])] |= CC_Operator;
+    return table;
+}
+
+#endif // LANGUAGE_H
@@ -1,6 +1,7 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include "json.hpp"
@@ -10,8 +11,16 @@ using json = nlohmann::json;
 struct Node {
     std::string label;
     std::vector<Node> children;
+    uint32_t offset = 0;    // source byte range, from the node's first token
+    uint32_t length = 0;    // to the end of its last token
+    uint32_t id = 0;        // preorder index in the parse tree, see assignNodeIds()
 };
 
-json nodeToJson(const Node& node);
+// Numbers `root` and its descendants 0, 1, 2, ... in preorder. Ids are
+// dense and depend only on the tree's shape, so the same source always
+// gets the same ids.
+void assignNodeIds(Node& root);
+
+json nodeToJson(const Node& node, bool includeSpans = false);
 
 #endif // NODE_H 
\ No newline at end of file
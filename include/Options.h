@@ -0,0 +1,35 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+#include "Diagnostics.h"
+#include "ExecutionBudget.h"
+#include "TracePolicy.h"
+#include "TraceWriter.h"
+#include "TreeWriter.h"
+
+struct Options {
+    bool hashCons = false;      // also write the hash-consed DAG to tree.dag.json
+    bool spans = false;         // emit [offset, length] source spans in tree.json
+    bool compactTree = false;   // write tree.json without indentation
+    unsigned treeThreads = 0;   // threads serializing tree.json (0 = one per core)
+    TreeSchema treeSchema = TreeSchema::Nested;
+    uint32_t treeDetailDepth = 0;   // split tree.json into parts below this many levels (0 = off)
+    size_t treeDetailNodes = 0;     // or beyond this many nodes per file (0 = off)
+    bool treeLayout = false;    // also write tree.layout.json and tree.tiles/ (see TreeLayout.h)
+    std::string diffFirst;      // --diff-trace: compare these two traces instead of parsing
+    std::string diffSecond;
+    bool bundle = false;        // also write artifacts.bundle (see ArtifactBundle.h)
+    std::string unbundlePath;   // --unbundle: convert this bundle to the JSON files instead of parsing
+    ExecutionBudget budget;
+    TracePolicy tracePolicy;
+    uint32_t stateKeyframes = 0;    // write trace.states.json with a keyframe every N changes (0 = off)
+    bool atomicWrites = false;  // write outputs to <file>.tmp and rename them into place
+    bool ioUring = true;        // write outputs through io_uring when the kernel supports it
+    bool streamTrace = false;   // write trace events while simulating instead of at the end
+    TraceWriterOptions traceOutput;
+};
+
+Result<Options> parseOptions(int argc, char* argv[]);
+
+#endif // OPTIONS_H
@@ -5,27 +5,69 @@
 #include <string>
 #include "Token.h"
 #include "Node.h"
+#include "Diagnostics.h"
+#include "Grammar.h"
+#include "Language.h"
+#include "languages/CppSubset.h"
 
+// The value of a grammar symbol while its rule is being parsed: the token
+// a terminal matched, or what a nonterminal's action built from its
+// symbols' values
+struct ParseValue {
+    const Token* token = nullptr;
+    Node node;                  // an empty label means no node
+    std::vector<Node> list;     // a repetition's nodes, last first
+};
+
+// What a semantic action sees besides the values
+struct ActionContext {
+    const Token& first;         // the alternative's first token
+    const Token* last;          // its last consumed token, null if none
+    std::string& scope;         // symbol-table scope: the function being parsed, or "global"
+
+    // Spans node over the alternative's tokens.
+    Node finish(Node node) const;
+
+    static Node leaf(std::string label, const Token& token);
+    static Node span(Node node, const Token& from, const Token& to);
+};
+
+// Table-driven LL(1) parser: expands the spec's grammar (see Grammar.h) on
+// an explicit stack and builds the tree with its semantic actions.
 class Parser {
 private:
+    struct Frame;
+
     std::vector<Token> tokens;
+    std::vector<uint8_t> terminals;     // each token's terminal id, then T_Eof
     size_t pos = 0;
     std::string currentScope = "global";
+    const LanguageSpec& spec;
+    const Grammar& grammar;
+    std::vector<Diagnostic> diagnostics;
+    Token endOfInput = {"eof", ""};
+    bool panicking = false;
 
-    Token peek();
-    Token advance();
-    bool match(const std::string& val);
-    bool matchType(const std::string& type);
-    Node parseFunction();
-    Node parseStatement();
-    Node parseExpression();
-    Node parseSimpleExpression();
+    const Token& current() const;
+    uint8_t classify(const Token& token) const;
+    Node fail(const Token& at, const std::string& message);
+    void synchronize(size_t start, uint64_t stops);
+    void synchronizeFunction(size_t start, uint64_t stops);
+    bool atFunctionHeader() const;
+    ActionContext context(size_t start);
+    size_t elementStart(const std::vector<Frame>& stack, int expanding) const;
+    std::string describe(std::string_view message, const std::vector<Frame>& stack, int expanding,
+                         const Token*& at) const;
+    std::string missing(const GrammarSymbol& symbol, const std::vector<Frame>& stack, const Token*& at);
+    void expand(const Frame& frame, std::vector<Frame>& stack, std::vector<ParseValue>& values);
+    void recover(const Token& at, const std::string& message, std::vector<Frame>& stack,
+                 std::vector<ParseValue>& values, int expanding);
 
 public:
-    Parser(const std::vector<Token>& tokens);
-    Node parse();
+    Parser(const std::vector<Token>& tokens, const LanguageSpec& spec = cppSubset);
+    Result<Node> parse();
 };
 
 extern std::vector<Node> allFunctions;
 
-#endif // PARSER_H 
\ No newline at end of file
+#endif // PARSER_H
@@ -0,0 +1,94 @@
+#ifndef STATE_TIMELINE_H
+#define STATE_TIMELINE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Bytecode.h"
+#include "Diagnostics.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// Variables of one live frame, by slot
+struct StateFrame {
+    uint32_t function;
+    std::vector<int> values;
+    std::vector<uint8_t> defined;
+};
+
+// One change to the variable state: a slot write, a call pushing a frame
+// or a return popping one.
+struct StateDelta {
+    enum Kind : uint8_t { Set, Call, Return };
+    Kind kind;
+    uint32_t depth;     // Set: frame index from the bottom of the stack
+    uint32_t target;    // Set: slot; Call: function
+    int value;
+};
+
+// Records the variable state of a VM run as a keyframe of every live frame
+// each `interval` deltas plus the deltas in between, and the delta count
+// at each trace event. The state at any event is the nearest keyframe
+// plus fewer than `interval` deltas.
+class StateRecorder {
+public:
+    explicit StateRecorder(uint32_t interval) : interval(interval) { keyframes.push_back({}); }
+
+    void set(uint32_t depth, uint32_t slot, int value) { record({StateDelta::Set, depth, slot, value}); }
+    void call(uint32_t function) { record({StateDelta::Call, 0, function, 0}); }
+    void ret() { record({StateDelta::Return, 0, 0, 0}); }
+    void event(uint64_t ordinal);
+
+    // Numbers events from trace event `ordinal` on, as 0, 1, ..., and drops
+    // the earlier ones: with --trace-last, trace.json starts there.
+    void rebase(uint64_t ordinal);
+
+    // Copies function and slot names out of the program that produced the deltas
+    void describe(const BytecodeProgram& program);
+
+    json toJson() const;
+
+private:
+    uint32_t interval;
+    std::vector<StateFrame> live;
+    std::vector<std::vector<StateFrame>> keyframes;
+    std::vector<StateDelta> deltas;
+    uint64_t firstEvent = 0;
+    std::vector<uint64_t> eventDeltas;      // trace event -> deltas applied before it
+    std::vector<std::string> functionNames;
+    std::vector<std::vector<std::string>> slotNames;
+
+    void record(const StateDelta& delta);
+};
+
+// Applies `delta` to a frame stack
+void applyStateDelta(std::vector<StateFrame>& frames, const StateDelta& delta);
+
+// Reader for trace.states.json
+class StateTimeline {
+public:
+    uint64_t firstEvent() const { return first; }
+    uint64_t eventCount() const { return eventDeltas.size(); }
+
+    // Variable state just before trace event `ordinal`
+    Result<std::vector<StateFrame>> stateAt(uint64_t ordinal) const;
+
+    // {"frames": [{"function": name, "variables": {name: value}}]}
+    json stateToJson(const std::vector<StateFrame>& frames) const;
+
+private:
+    uint32_t interval = 0;
+    uint64_t first = 0;
+    std::vector<std::vector<StateFrame>> keyframes;
+    std::vector<StateDelta> deltas;
+    std::vector<uint64_t> eventDeltas;
+    std::vector<std::string> functionNames;
+    std::vector<std::vector<std::string>> slotNames;
+
+    friend Result<StateTimeline> loadStateTimeline(const std::string& path);
+};
+
+Result<StateTimeline> loadStateTimeline(const std::string& path);
+
+#endif // STATE_TIMELINE_H
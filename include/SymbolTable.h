@@ -2,6 +2,8 @@
 #define SYMBOL_TABLE_H
 
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include "Node.h"
 
@@ -14,6 +16,10 @@ struct SymbolEntry {
 };
 
 extern std::vector<SymbolEntry> symbolTable;
+bool parseIntLiteral(std::string_view text, int& value);
 int evalExpr(const Node& expr, std::unordered_map<std::string, int>& vars);
 
+// symbol_table.json rows: name, type, scope and, when known, value
+json symbolTableToJson(const std::vector<SymbolEntry>& symbols);
+
 #endif // SYMBOL_TABLE_H 
\ No newline at end of file
@@ -1,11 +1,15 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include <cstdint>
 #include <string>
 
 struct Token {
     std::string type;
     std::string value;
+    int line = 0;
+    int column = 0;
+    uint32_t offset = 0;
 };
 
 #endif // TOKEN_H 
\ No newline at end of file
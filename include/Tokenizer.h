@@ -4,7 +4,10 @@
 #include <vector>
 #include <string>
 #include "Token.h"
+#include "Diagnostics.h"
+#include "Language.h"
+#include "languages/CppSubset.h"
 
-std::vector<Token> tokenize(const std::string& code);
+Result<std::vector<Token>> tokenize(const std::string& code, const LanguageSpec& spec = cppSubset);
 
-#endif // TOKENIZER_H 
\ No newline at end of file
+#endif // TOKENIZER_H
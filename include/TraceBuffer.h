@@ -0,0 +1,106 @@
+#ifndef TRACE_BUFFER_H
+#define TRACE_BUFFER_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "TraceEvent.h"
+
+struct StringPool {
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> ids;
+
+    uint32_t intern(const std::string& s);
+    const std::string& operator[](uint32_t id) const { return strings[id]; }
+};
+
+// Append-only trace storage in fixed-size chunks, so recording an event
+// never moves existing records and only allocates once per chunk.
+//
+// In streaming mode every full chunk is handed to the consumer and then
+// reused, so memory stays at one chunk however long the trace gets; only
+// the events since the last hand-over are indexable.
+//
+// With keepLast(n) the buffer is a ring of the newest n events: once full,
+// each push overwrites the oldest one.
+class TraceBuffer {
+public:
+    static constexpr size_t kChunkEvents = 4096;
+
+    using Consumer = std::function<void(const TraceEvent* events, size_t count)>;
+
+    StringPool names;
+
+    void push(const TraceEvent& event) {
+        if (ring && count == ring) {
+            at(head) = event;
+            if (++head == ring)
+                head = 0;
+            ++dropped;
+            return;
+        }
+        size_t chunk = count / kChunkEvents;
+        if (chunk == chunks.size())
+            chunks.emplace_back(new TraceEvent[kChunkEvents]);
+        chunks[chunk][count % kChunkEvents] = event;
+        if (++count == kChunkEvents && consumer)
+            handOver();
+    }
+
+    // Total events recorded, including those streamed out or overwritten
+    size_t size() const { return streamed + dropped + count; }
+    bool empty() const { return size() == 0; }
+    size_t retained() const { return count; }
+
+    // i-th retained event, oldest first
+    const TraceEvent& operator[](size_t i) const {
+        size_t index = head + i;
+        if (ring && index >= ring)
+            index -= ring;
+        return chunks[index / kChunkEvents][index % kChunkEvents];
+    }
+
+    // Turns the buffer into a ring of the newest `events` events (0 = keep
+    // all). Call before recording; not combinable with streaming.
+    void keepLast(size_t events) {
+        clear();
+        ring = events;
+    }
+
+    void streamTo(Consumer fn) { consumer = std::move(fn); }
+
+    // Hands any retained events to the consumer
+    void flushStream() {
+        if (consumer && count)
+            handOver();
+    }
+
+    // Keeps allocated chunks for reuse
+    void clear() {
+        count = 0;
+        streamed = 0;
+        dropped = 0;
+        head = 0;
+    }
+
+private:
+    std::vector<std::unique_ptr<TraceEvent[]>> chunks;
+    size_t count = 0;
+    size_t streamed = 0;
+    size_t ring = 0;
+    size_t head = 0;            // oldest event once the ring is full
+    size_t dropped = 0;
+    Consumer consumer;
+
+    TraceEvent& at(size_t index) { return chunks[index / kChunkEvents][index % kChunkEvents]; }
+
+    void handOver() {
+        consumer(chunks[0].get(), count);
+        streamed += count;
+        count = 0;
+    }
+};
+
+#endif // TRACE_BUFFER_H
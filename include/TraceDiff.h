@@ -0,0 +1,40 @@
+#ifndef TRACE_DIFF_H
+#define TRACE_DIFF_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Diagnostics.h"
+
+// A stretch where two traces disagree: events [aBegin, aEnd) of the first
+// trace were replaced by events [bBegin, bEnd) of the second.
+struct TraceRegion {
+    uint64_t aBegin, aEnd;
+    uint64_t bBegin, bEnd;
+};
+
+struct TraceDiff {
+    bool identical = true;
+    uint64_t firstDivergence = 0;
+    std::vector<TraceRegion> regions;
+};
+
+// Aligns two traces given as per-event hashes. Identical windows of
+// kDiffWindow events that occur once in each trace anchor the alignment
+// (found with a rolling hash, ordered by a longest increasing
+// subsequence); matches are then extended event by event from each
+// anchor. Runs in O(n log n).
+constexpr size_t kDiffWindow = 16;
+TraceDiff diffTraces(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b);
+
+// Events of a trace file as compact JSON text, one per event. Reads
+// trace.json (folded or not), NDJSON, a chunk manifest or a columnar trace.
+// Malformed files are reported in the diagnostics; nothing is thrown.
+Result<std::vector<std::string>> loadTraceEvents(const std::string& path);
+
+// --diff-trace: prints the first divergence and the changed regions.
+// Returns 0 for identical traces, 1 when they differ, 2 on errors.
+int runTraceDiff(const std::string& first, const std::string& second, std::ostream& out);
+
+#endif // TRACE_DIFF_H
@@ -0,0 +1,57 @@
+#ifndef TRACE_EVENT_H
+#define TRACE_EVENT_H
+
+#include <cstdint>
+
+enum class TraceAction : uint8_t {
+    Call,
+    Return,
+    ReturnStmt,
+    VarDecl,
+    Assign,
+    IfEnter,
+    IfTaken,
+    WhileEnter,
+    ForEnter,
+    Cout,
+    Cin,
+    BudgetExhausted
+};
+
+constexpr uint32_t kTraceActionCount = static_cast<uint32_t>(TraceAction::BudgetExhausted) + 1;
+constexpr uint32_t kNoName = UINT32_MAX;
+constexpr uint32_t kNoNode = UINT32_MAX;
+
+// Fixed-size trace record. `name` indexes the trace's string pool and holds
+// the function, variable or exhausted limit depending on `action`.
+struct TraceEvent {
+    TraceAction action;
+    uint8_t branch;         // IfTaken: 1 = then, 0 = else
+    uint16_t reserved;
+    uint32_t name;
+    uint32_t node;          // id of the parse-tree node that produced the event
+    int32_t value;          // VarDecl / Assign: the value stored
+    uint64_t step;          // VM instructions executed when it was recorded
+};
+
+static_assert(sizeof(TraceEvent) == 24, "TraceEvent must stay a compact POD record");
+
+// Whether the event changes a variable, and so carries `value`
+inline bool traceEventHasValue(TraceAction action) {
+    return action == TraceAction::VarDecl || action == TraceAction::Assign;
+}
+
+// Whether `name` holds the event's payload; the other actions carry
+// kNoName
+inline bool traceEventHasName(TraceAction action) {
+    return action == TraceAction::Call || action == TraceAction::Return || action == TraceAction::VarDecl ||
+           action == TraceAction::Assign || action == TraceAction::BudgetExhausted;
+}
+
+const char* traceActionName(TraceAction action);
+
+// JSON key carrying the event's payload ("function", "variable", "branch"
+// or "limit"), or nullptr when the action has none.
+const char* traceEventField(TraceAction action);
+
+#endif // TRACE_EVENT_H
@@ -0,0 +1,38 @@
+#ifndef TRACE_FOLDING_H
+#define TRACE_FOLDING_H
+
+#include <cstdint>
+#include <vector>
+#include "Diagnostics.h"
+#include "TraceBuffer.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// One element of a folded trace: either a single event (`body` empty) or
+// `repeat` consecutive copies of the runs in `body`.
+struct TraceRun {
+    uint32_t repeat;
+    uint64_t hash;
+    size_t event;
+    std::vector<TraceRun> body;
+};
+
+// Detects back-to-back repetitions of event sequences up to `maxPeriod`
+// runs long (loop iterations, repeated call/return pairs) and folds them.
+// Folding is applied again to its own output, so a loop whose iterations
+// contain an inner folded loop folds as well. Event values only count
+// when `values` says they will be written.
+std::vector<TraceRun> foldTrace(const TraceBuffer& buffer, size_t maxPeriod = 32, bool values = false);
+
+// Folded trace.json: events, with repeated segments written as
+// {"repeat": n, "events": [...]}
+json foldedTraceToJson(const std::vector<TraceRun>& runs, const TraceBuffer& buffer, bool values = false);
+
+// Lossless inverse of the folded form; plain event arrays pass through.
+// Folded traces are read back from disk, so a block that is not
+// {"repeat": n, "events": [...]} with n a 32-bit count is reported
+// rather than trusted.
+Result<json> expandTrace(const json& events);
+
+#endif // TRACE_FOLDING_H
@@ -4,8 +4,20 @@
 #include <unordered_map>
 #include "Node.h"
 #include "json.hpp"
+#include "ExecutionBudget.h"
+#include "TracePolicy.h"
+#include "StateTimeline.h"
+#include "TraceBuffer.h"
 
-extern std::vector<json> trace;
-void simulateExecution(const Node& node, std::unordered_map<std::string, int>& vars);
+extern TraceBuffer trace;
+
+// Converts records to the trace.json event objects at write time; with
+// `values`, vardecl / assign events also get a "value" key.
+json traceEventToJson(const TraceEvent& event, const StringPool& names, bool values = false);
+json traceToJson(const TraceBuffer& buffer, bool values = false);
+
+ExecutionStatus simulateExecution(const Node& node, std::unordered_map<std::string, int>& vars,
+                                  const ExecutionBudget& budget = {}, const TracePolicy& policy = {},
+                                  StateRecorder* states = nullptr);
 
 #endif // TRACE_GENERATOR_H 
\ No newline at end of file
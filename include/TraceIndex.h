@@ -0,0 +1,62 @@
+#ifndef TRACE_INDEX_H
+#define TRACE_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Diagnostics.h"
+#include "TraceBuffer.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// Sidecar index written next to the trace (trace.index.json). It lists,
+// per function and per variable, the sorted ordinals of the events that
+// mention it, and the byte offset of every kStride-th event so a reader
+// can seek close to any event instead of parsing the file from the start.
+struct TraceIndex {
+    static constexpr uint64_t kStride = 64;
+
+    struct File {
+        std::string path;
+        uint64_t first;     // ordinal of the file's first event
+        uint64_t offset;    // byte offset of that event
+    };
+
+    uint64_t events = 0;
+    std::vector<File> files;
+    std::vector<uint64_t> offsets;      // event i * kStride -> byte offset in its file
+    std::unordered_map<std::string, std::vector<uint64_t>> functions;   // call / return events
+    std::unordered_map<std::string, std::vector<uint64_t>> variables;   // vardecl / assign events
+};
+
+// Collects the index while TraceWriter writes events.
+class TraceIndexBuilder {
+public:
+    void beginFile(const std::string& path);
+    void add(uint64_t ordinal, const TraceEvent& event, uint64_t offset);
+    json toJson(const StringPool& names) const;
+
+private:
+    uint64_t events = 0;
+    std::vector<TraceIndex::File> files;
+    bool fileStarted = false;
+    std::vector<uint64_t> offsets;
+    std::vector<std::vector<uint64_t>> functions;   // by string pool id
+    std::vector<std::vector<uint64_t>> variables;
+};
+
+// Fails on a malformed index, or one whose files and offsets could send
+// readTraceEvent outside the index
+Result<TraceIndex> loadTraceIndex(const std::string& path);
+
+// Ordinals of the events mentioning `name`, or an empty list
+const std::vector<uint64_t>& functionEvents(const TraceIndex& index, const std::string& name);
+const std::vector<uint64_t>& variableEvents(const TraceIndex& index, const std::string& name);
+
+// Reads event `ordinal` by seeking to the nearest indexed offset. Trace
+// files are looked up relative to `directory`.
+Result<json> readTraceEvent(const TraceIndex& index, uint64_t ordinal, const std::string& directory = ".");
+
+#endif // TRACE_INDEX_H
@@ -0,0 +1,20 @@
+#ifndef TRACE_POLICY_H
+#define TRACE_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Which trace events a simulation run keeps. Filtering happens where the
+// VM would record the event, so dropped events never reach the buffer.
+enum class TraceGranularity {
+    Function,       // call / return only
+    Statement       // every event (the default)
+};
+
+struct TracePolicy {
+    TraceGranularity granularity = TraceGranularity::Statement;
+    uint32_t sampleEvery = 1;       // keep every Nth event that passes the granularity filter
+    size_t keepLast = 0;            // keep only the newest N events (0 = keep all)
+};
+
+#endif // TRACE_POLICY_H
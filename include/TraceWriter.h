@@ -0,0 +1,89 @@
+#ifndef TRACE_WRITER_H
+#define TRACE_WRITER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BufferedSink.h"
+#include "TraceBuffer.h"
+#include "TraceIndex.h"
+#include "ColumnarTrace.h"
+
+enum class TraceFormat {
+    Json,       // one pretty-printed array, identical to the old json(trace).dump(4)
+    NdJson,     // one compact event object per line
+    Columnar    // trace.columns, see ColumnarTrace.h
+};
+
+struct TraceWriterOptions {
+    TraceFormat format = TraceFormat::Json;
+    std::string basePath = "trace";     // trace.json / trace.ndjson
+    uint64_t chunkEvents = 0;           // rotate files after this many events (0 = single file)
+    bool values = false;                // add "value" to vardecl / assign events
+    bool index = false;                 // also write trace.index.json (see TraceIndex.h)
+    bool fold = false;                  // fold repeated segments (see TraceFolding.h)
+    size_t foldPeriod = 32;
+    bool atomic = false;                // write each file to <file>.tmp and rename it when complete
+};
+
+// Writes trace events through a buffered sink as they are produced. With
+// chunkEvents set, output rotates into trace.0000.json, trace.0001.json, ...
+// and finish() writes trace.manifest.json describing the chunks. With fold
+// set, write(buffer) emits the whole folded trace as one JSON document.
+// With atomic set, every file (a streamed trace and each chunk included) is
+// renamed into place when it is closed, and the manifest only after the
+// chunks it lists.
+class TraceWriter {
+public:
+    explicit TraceWriter(const TraceWriterOptions& options);
+    ~TraceWriter();
+
+    void write(const TraceEvent& event, const StringPool& names);
+    void write(const TraceBuffer& buffer);      // every retained event
+    void finish();
+
+    uint64_t eventCount() const { return events; }
+
+    // False if writing any file failed: the trace or one of its chunks, the
+    // columns, the manifest or the index. Check after finish().
+    bool ok() const { return !failed; }
+    std::string outputPath() const;
+
+private:
+    struct Chunk {
+        std::string file;
+        uint64_t first;
+        uint64_t count;
+        uint64_t bytes;
+    };
+
+    TraceWriterOptions options;
+    std::unique_ptr<BufferedSink> sink;
+    std::vector<Chunk> chunks;
+    uint64_t events = 0;
+    uint64_t inFile = 0;
+    bool finished = false;
+    bool failed = false;
+    TraceIndexBuilder index;
+    ColumnarTraceBuilder columns;
+    const StringPool* names = nullptr;          // pool of the events written so far
+
+    std::string extension() const;
+    void openFile();
+    void closeFile();
+    void writeFolded(const TraceBuffer& buffer);
+};
+
+// Removes the trace files an earlier run may have left under
+// options.basePath that a TraceWriter with `options` does not rewrite: the
+// other formats, the manifest, every chunk and the index. The visualizer
+// tries trace.manifest.json before trace.json, so a leftover manifest would
+// hide the new trace.
+void removeStaleTraceOutputs(const TraceWriterOptions& options);
+
+// Removes every trace file under `basePath`, whatever its format, with the
+// index and states files: for runs that write no trace at all.
+void removeTraceOutputs(const std::string& basePath);
+
+#endif // TRACE_WRITER_H
@@ -0,0 +1,60 @@
+#ifndef TREE_LAYOUT_H
+#define TREE_LAYOUT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Node.h"
+#include "TraceEvent.h"
+
+struct TreeLayoutOptions {
+    double siblingSeparation = 1;   // horizontal gap between siblings, in layout units
+    double cousinSeparation = 2;    // gap between neighbours with different parents (as d3.tree)
+    double tileWidth = 0;           // spatial index cell in layout units (0 = about
+                                    // kLayoutTileNodes nodes per tile)
+    uint32_t tileDepth = 8;         // and in tree levels
+    bool atomic = false;            // writeTreeLayout(): stage each file as <file>.tmp
+};
+
+constexpr size_t kLayoutTileNodes = 1024;
+
+// Tidy-tree positions for every node, indexed by preorder position (which
+// is the node id). x is in layout units with the leftmost node at 0; the
+// vertical position is the node's depth.
+struct TreeLayout {
+    std::vector<const Node*> nodes;
+    std::vector<uint32_t> parent;   // kNoNode for the root
+    std::vector<uint32_t> depth;
+    std::vector<double> x;
+    double width = 0;
+    uint32_t height = 0;            // deepest level
+};
+
+// Reingold-Tilford layout in linear time (Buchheim, Juenger and Leipert's
+// refinement of Walker's algorithm, the one d3.tree() uses): parents are
+// centred over their children and subtrees are packed as closely as the
+// separations allow.
+TreeLayout layoutTree(const Node& root, const TreeLayoutOptions& options = {});
+
+// Grid cell of the spatial index holding the nodes positioned inside it
+struct LayoutTile {
+    uint32_t column;
+    uint32_t row;
+    std::vector<uint32_t> nodes;
+};
+
+// Cell width actually used: options.tileWidth, or the automatic choice
+double layoutTileWidth(const TreeLayout& layout, const TreeLayoutOptions& options = {});
+
+// Non-empty tiles, ordered by row then column
+std::vector<LayoutTile> tileLayout(const TreeLayout& layout, const TreeLayoutOptions& options = {});
+
+// Writes <basePath>.layout.json (bounds, root position, tile size and the
+// list of tiles) and one <basePath>.tiles/<column>_<row>.json per tile,
+// whose nodes are [id, x, depth, parent id (-1 for the root), parent x,
+// child count, name]. The visualizer fetches only the tiles in view.
+// The layout file is written last, once every tile it lists is in place.
+bool writeTreeLayout(const TreeLayout& layout, const std::string& basePath,
+                     const TreeLayoutOptions& options = {});
+
+#endif // TREE_LAYOUT_H
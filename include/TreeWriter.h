@@ -0,0 +1,54 @@
+#ifndef TREE_WRITER_H
+#define TREE_WRITER_H
+
+#include <string>
+#include "BufferedSink.h"
+#include "Node.h"
+
+enum class TreeSchema {
+    Nested,         // {"children": [...], "id", "name"} objects, as nodeToJson()
+    Dictionary      // version 2: label tables plus one flat preorder array
+};
+
+// Dictionary schema (always written without whitespace):
+//
+//   {"version": 2, "prefixes": [...], "strings": [...],
+//    "nodes": [prefix, string, childCount, ...], "spans": [offset, length, ...]}
+//
+// Each label is split after its first ": " ("Value: " + "x"); both halves
+// are indices into the tables. Nodes are in preorder, so a node's position
+// is its id and its children follow it. "spans" is present with spans on.
+// The nested schema has no "version" key.
+constexpr int kTreeDictionaryVersion = 2;
+
+struct TreeWriterOptions {
+    TreeSchema schema = TreeSchema::Nested;
+    bool pretty = true;     // byte-identical to nodeToJson(...).dump(4); otherwise dump()
+    bool spans = false;     // include "span": [offset, length]
+    unsigned threads = 1;   // serialize top-level subtrees in parallel (0 = one per core)
+    uint32_t detailDepth = 0;   // writeTreeLevels(): levels per file (0 = unlimited)
+    size_t detailNodes = 0;     // and nodes per file (0 = unlimited, else at least 3)
+    bool atomicParts = false;   // writeTreeLevels(): stage each part file as <file>.tmp
+};
+
+// Streams `root` as tree.json text straight into `sink`. The nested schema
+// gives the same bytes as nodeToJson() followed by dump() without building
+// the DOM; with several threads the output is still byte-identical.
+void writeTree(const Node& root, BufferedSink& sink, const TreeWriterOptions& options = {});
+
+bool writeTreeFile(const Node& root, const std::string& path, const TreeWriterOptions& options = {});
+
+// Level-of-detail export in the nested schema. `path` gets the top of the
+// tree, down to detailDepth levels or detailNodes nodes; each subtree cut
+// off there is written as a stub, {"children": [], "collapsed": <hidden
+// descendants>, "id", "name"}, and its content goes to
+// <partsDirectory>/<id>.json, itself limited the same way. A node with
+// more children than detailNodes allows shows them a page at a time: the
+// page ends in {"children": [], "collapsed", "from": <next child index>,
+// "id": <parent id>, "name": "..."} and the rest of the children go to
+// <partsDirectory>/<id>-<from>.json. The visualizer loads a part when its
+// stub is expanded.
+bool writeTreeLevels(const Node& root, const std::string& path, const std::string& partsDirectory,
+                     const TreeWriterOptions& options = {});
+
+#endif // TREE_WRITER_H
@@ -0,0 +1,73 @@
+#ifndef VM_H
+#define VM_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "Bytecode.h"
+#include "ExecutionBudget.h"
+#include "TracePolicy.h"
+#include "StateTimeline.h"
+
+// Slot values of one frame; `defined` tracks which slots have been assigned.
+struct VariableStore {
+    std::vector<int> values;
+    std::vector<uint8_t> defined;
+
+    void resize(size_t count) {
+        values.resize(count, 0);
+        defined.resize(count, 0);
+    }
+};
+
+struct Frame {
+    uint32_t function;
+    uint32_t returnIp;
+    uint32_t base;      // first slot of this frame in the slot pool
+};
+
+class VM {
+private:
+    const BytecodeProgram& program;
+    std::vector<int> stack;
+    std::vector<uint32_t> loopCounters;
+    std::vector<uint32_t> traceNames;   // program name id -> trace string pool id
+
+    // Frames are carved out of one reusable slot pool, so calls do not
+    // allocate once the pool has grown to the deepest recursion seen.
+    std::vector<Frame> frames;
+    std::vector<int> slotValues;
+    std::vector<uint8_t> slotDefined;
+    uint32_t slotTop = 0;
+
+    ExecutionBudget budget;
+    uint64_t steps = 0;
+    uint64_t nextCheck = 0;             // step count at which checkBudget() runs next
+    uint64_t traceLimit = 0;            // trace size at which the event budget is spent
+    std::chrono::steady_clock::time_point deadline;
+    ExecutionStatus status = ExecutionStatus::Completed;
+
+    TracePolicy policy;
+    uint32_t traceMask = 0;             // bit per TraceAction the granularity keeps
+    uint32_t sampleSkip = 0;            // events still to drop before the next sample
+    StateRecorder* states = nullptr;    // variable-state history, when requested
+    int lastStored = 0;                 // value of the latest Store, for vardecl / assign events
+
+    void pushFrame(uint32_t function, uint32_t returnIp);
+    void recordTrace(const Instruction& ins);
+    bool checkBudget();
+
+public:
+    explicit VM(const BytecodeProgram& program, const ExecutionBudget& budget = {},
+                const TracePolicy& policy = {})
+        : program(program), budget(budget), policy(policy) {}
+
+    void recordStates(StateRecorder* recorder) { states = recorder; }
+
+    // Runs entry function `function` with its frame seeded from (and
+    // written back to) `vars`, which is indexed by slot. Stops early with a
+    // terminating trace event when the budget runs out.
+    ExecutionStatus run(uint32_t function, VariableStore& vars);
+};
+
+#endif // VM_H
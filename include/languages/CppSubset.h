@@ -0,0 +1,110 @@
+#ifndef LANGUAGES_CPP_SUBSET_H
+#define LANGUAGES_CPP_SUBSET_H
+
+#include "Language.h"
+
+namespace cpp_subset {
+
+inline constexpr std::string_view keywords[] = {
+    "int", "void", "float", "double", "char", "bool", "string",
+    "return", "if", "else", "while", "for", "switch", "case",
+    "break", "continue", "cout", "cin", "enum", "struct",
+    "const", "true", "false"
+};
+
+inline constexpr std::string_view typeNames[] = {
+    "int", "void", "float", "double", "char", "bool", "string"
+};
+
+inline constexpr std::string_view operators[] = {
+    "<<", ">>", "==", "!=", "<=", ">=", "++", "--"
+};
+
+inline constexpr std::string_view binaryOperators[] = {
+    "+", "-", "*", "/", "%", "==", "!=", "<", ">", "<=", ">="
+};
+
+inline constexpr std::string_view singleSymbols = "(){};,=+*/-<>%.[]:";
+
+// The syntax, in the notation described in Grammar.h. The actions are in
+// src/languages/CppSubset.cpp, which builds the parse tables from this.
+inline constexpr std::string_view grammar = R"grammar(
+Program -> Items => program
+
+Items [function] -> ~ | * Item Items => prepend
+Item -> PREPROCESSOR => include
+      | 'using' 'namespace' "Expected namespace" IDENT "Expected namespace name" UsingEnd => usingNamespace
+      | * Function
+UsingEnd -> ';' | * ~
+
+Function -> TYPE IDENT "Expected function name" {enterScope} Parameters Body => function
+          | * "Expected return type"
+Parameters -> '(' "Expected (" ParameterList => parameters
+ParameterList -> ')' | * Parameter MoreParameters ')' "Expected )" => prepend
+Parameter -> TYPE "Expected parameter type" IDENT "Expected parameter name" => parameter
+MoreParameters -> ',' Parameter MoreParameters => prependSecond | * ~
+Body -> '{' "Expected {" Statements => body
+
+Statements [statement] -> '}' | * Statement Statements => prepend
+Statement -> TYPE IDENT "Expected variable name" Initializer ';' "Expected ; after variable declaration" => declaration
+           | 'return' Expr ';' "Expected ; after return" => returnStatement
+           | 'if' '(' "Expected ( after if" Expr ')' "Expected ) after if condition" Statement Else => ifStatement
+           | 'while' '(' "Expected ( after while" Expr ')' "Expected ) after while condition" Statement => whileStatement
+           | 'for' '(' "Expected ( after for" ForInit ForCondition ';' "Expected ; after for condition"
+             ForUpdate ')' "Expected ) after for header" Statement => forStatement
+           | 'cout' '<<' "Expected << after cout" Expr CoutItems ';' "Expected ; after cout" => coutStatement
+           | 'cin' '>>' "Expected >> after cin" IDENT "Expected variable after >>" CinItems ';' "Expected ; after cin" => cinStatement
+           | '{' Statements => block
+           | IDENT IdentStatement => identStatement
+           | '++' StepTarget ';' "Expected ; after ++" => prefixStep
+           | '--' StepTarget ';' "Expected ; after --" => prefixStep
+           | * "Unknown statement starting with: $"
+IdentStatement -> '=' Expr ';' "Expected ; after assignment" => assignTail
+                | Arguments ';' "Expected ; after function call" => callTail
+                | '++' ';' "Expected ; after ++" => stepTail
+                | '--' ';' "Expected ; after --" => stepTail
+                | * "Unknown statement starting with: $"
+StepTarget -> IDENT | * "Unknown statement starting with: $"
+Initializer -> '=' Expr => second | * ~
+Else -> 'else' Statement => second | * ~
+ForInit -> ';' | * Statement
+ForCondition -> ~ => alwaysTrue | * Expr
+ForUpdate -> ~ => noUpdate
+           | '++' PrefixUpdate => prefixUpdate
+           | '--' PrefixUpdate => prefixUpdate
+           | IDENT UpdateTail => identUpdate
+           | * Expr
+PrefixUpdate -> IDENT | * ExprTail
+UpdateTail -> '++' => stepTail | '--' => stepTail | '=' Expr => assignTail | * CallOpt ExprTail => exprTail
+CoutItems -> '<<' Expr CoutItems => prependSecond | * ~
+CinItems -> '>>' IDENT "Expected variable after >>" CinItems => prependVar | * ~
+
+Expr -> Primary ExprTail => expression
+ExprTail -> BINOP Primary ExprTail => binaryTail | * ~
+Primary -> IDENT CallOpt => identPrimary | * ANY => value
+CallOpt -> Arguments | * ~
+Arguments -> '(' ArgumentList ')' "Expected ) after function call arguments" => arguments
+ArgumentList -> ~ | * Expr MoreArguments => prepend
+MoreArguments -> ',' Expr MoreArguments => prependSecond | * ~
+)grammar";
+
+// Built from `grammar` at compile time in src/languages/CppSubset.cpp
+extern const Grammar grammarTables;
+
+} // namespace cpp_subset
+
+inline constexpr LanguageSpec cppSubset = {
+    "cpp-subset",
+    {cpp_subset::keywords, std::size(cpp_subset::keywords)},
+    {cpp_subset::typeNames, std::size(cpp_subset::typeNames)},
+    {cpp_subset::operators, std::size(cpp_subset::operators)},
+    {cpp_subset::binaryOperators, std::size(cpp_subset::binaryOperators)},
+    &cpp_subset::grammarTables,
+    {'"', "string"},
+    {'\'', "identifier"}, // char literals have always been reported as identifiers
+    '#',
+    buildCharClasses(cpp_subset::singleSymbols,
+                     {cpp_subset::operators, std::size(cpp_subset::operators)})
+};
+
+#endif // LANGUAGES_CPP_SUBSET_H
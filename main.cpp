@@ -1,15 +1,59 @@
 #include <iostream>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
+#include <memory>
 #include "Token.h"
 #include "Node.h"
 #include "Parser.h"
 #include "Tokenizer.h"
 #include "SymbolTable.h"
 #include "TraceGenerator.h"
+#include "Options.h"
+#include "HashCons.h"
+#include "TraceWriter.h"
+#include "StateTimeline.h"
+#include "TraceDiff.h"
+#include "TreeWriter.h"
+#include "ArtifactBundle.h"
+#include "ArtifactWriter.h"
+#include "AsyncFile.h"
+#include "TreeLayout.h"
 using namespace std;
 
-int main() {
+static void reportDiagnostics(const vector<Diagnostic>& diagnostics) {
+    for (const auto& d : diagnostics)
+        cerr << "Error: " << d.line << ":" << d.column << ": " << d.message << endl;
+}
+
+// The visualizer prefers tree.layout.json and follows stubs into
+// tree.parts/, so outputs an earlier run left there would show a stale
+// tree. Runs that write tree.json start by removing them; --tree-layout
+// and --tree-depth / --tree-nodes write them afresh.
+static void removeTreeExtras() {
+    error_code ignored;
+    filesystem::remove("tree.layout.json", ignored);
+    filesystem::remove_all("tree.tiles", ignored);
+    filesystem::remove_all("tree.parts", ignored);
+}
+
+int main(int argc, char* argv[]) {
+    auto parsedOptions = parseOptions(argc, argv);
+    if (!parsedOptions.ok()) {
+        for (const auto& d : parsedOptions.diagnostics)
+            cerr << "Error: " << d.message << endl;
+        return 1;
+    }
+    const Options& options = parsedOptions.value;
+    setIoUringEnabled(options.ioUring);
+    if (!options.diffFirst.empty())
+        return runTraceDiff(options.diffFirst, options.diffSecond, cout);
+    if (!options.unbundlePath.empty()) {
+        removeTreeExtras();
+        removeStaleTraceOutputs(TraceWriterOptions());
+        return runUnbundle(options.unbundlePath, cout, options.atomicWrites);
+    }
+
     ifstream file("input.cpp");
     if (!file.is_open()) {
         cerr << "Failed to open input.cpp\n";
@@ -18,57 +62,153 @@ int main() {
     stringstream buffer;
     buffer << file.rdbuf();
     string code = buffer.str();
+    removeTreeExtras();
+    // Likewise for trace files in another format or from a chunked run
+    removeStaleTraceOutputs(options.traceOutput);
+    if (!options.stateKeyframes) {
+        error_code ignored;
+        filesystem::remove(options.traceOutput.basePath + ".states.json", ignored);
+    }
 
     try {
         cout << "Starting tokenization...\n";
-        auto tokens = tokenize(code);
+        auto lexed = tokenize(code);
         cout << "Tokenization complete.\n\n";
 
         cout << "Starting parsing...\n";
-        Parser parser(tokens);
-        Node tree = parser.parse();
-        json output = nodeToJson(tree);
+        Parser parser(lexed.value);
+        auto parsed = parser.parse();
+        Node& tree = parsed.value;
+        TreeWriterOptions treeOutput;
+        treeOutput.pretty = !options.compactTree;
+        treeOutput.spans = options.spans;
+        treeOutput.threads = options.treeThreads;
+        treeOutput.schema = options.treeSchema;
+        treeOutput.detailDepth = options.treeDetailDepth;
+        treeOutput.detailNodes = options.treeDetailNodes;
+        treeOutput.atomicParts = options.atomicWrites;
+        auto writeTree = [&](const string& path) {
+            if (options.treeDetailDepth || options.treeDetailNodes)
+                return writeTreeLevels(tree, path, "tree.parts", treeOutput);
+            return writeTreeFile(tree, path, treeOutput);
+        };
+        if (!lexed.ok() || !parsed.ok()) {
+            // Report every diagnostic and still emit the partial tree for the
+            // visualizer, written as a complete one would be. Nothing was
+            // simulated, so no earlier run's trace may stay next to it.
+            reportDiagnostics(lexed.diagnostics);
+            reportDiagnostics(parsed.diagnostics);
+            removeTraceOutputs(options.traceOutput.basePath);
+            ArtifactWriter partial(options.atomicWrites);
+            partial.produce("tree.json", writeTree);
+            if (!partial.wait()) {
+                for (const auto& failure : partial.failures())
+                    cerr << "Error: " << failure << endl;
+                return 1;
+            }
+            cerr << "Partial parse tree written to tree.json\n";
+            return 1;
+        }
         cout << "Parsing complete.\n\n";
 
+        TraceWriter traceWriter(options.traceOutput);
+        if (options.tracePolicy.keepLast)
+            trace.keepLast(options.tracePolicy.keepLast);
+        if (options.streamTrace) {
+            // Events go to disk chunk by chunk while the simulation runs
+            trace.streamTo([&](const TraceEvent* events, size_t count) {
+                for (size_t i = 0; i < count; ++i)
+                    traceWriter.write(events[i], trace.names);
+            });
+        }
+
+        unique_ptr<StateRecorder> states;
+        if (options.stateKeyframes)
+            states.reset(new StateRecorder(options.stateKeyframes));
+
         cout << "Starting execution simulation...\n";
         // Simulate execution starting from main
         for (const auto& func : allFunctions) {
             for (const auto& fchild : func.children) {
                 if (fchild.label == "FunctionName: main") {
                     unordered_map<string, int> vars;
-                    simulateExecution(func, vars);
+                    ExecutionStatus status = simulateExecution(func, vars, options.budget, options.tracePolicy,
+                                                               states.get());
+                    if (status != ExecutionStatus::Completed)
+                        cout << "Execution stopped: " << executionStatusName(status) << " budget exhausted.\n";
                 }
             }
         }
         cout << "Execution simulation complete.\n\n";
+        // The functions were copied out of the tree for the simulation only
+        vector<Node>().swap(allFunctions);
+        // States are numbered like the events written to trace.json
+        if (states && options.tracePolicy.keepLast)
+            states->rebase(trace.size() - trace.retained());
+
+        // Output files are written concurrently; jobs only read the tree,
+        // trace and symbol table, which stay untouched until wait()
+        ArtifactWriter artifacts(options.atomicWrites);
 
         cout << "Writing parse tree to tree.json...\n";
-        // Write parse tree
-        ofstream out("tree.json");
-        out << output.dump(4);
-        cout << "Parse tree written successfully.\n\n";
+        artifacts.produce("tree.json", writeTree);
 
-        cout << "Writing execution trace to trace.json...\n";
-        // Write trace
-        ofstream traceOut("trace.json");
-        traceOut << json(trace).dump(4);
-        cout << "Execution trace written successfully.\n\n";
+        if (options.treeLayout) {
+            cout << "Laying out parse tree into tree.layout.json and tree.tiles/...\n";
+            TreeLayoutOptions layoutOutput;
+            layoutOutput.atomic = options.atomicWrites;
+            artifacts.run([&, layoutOutput] { return writeTreeLayout(layoutTree(tree), "tree", layoutOutput); },
+                          "tree.layout.json");
+        }
+
+        cout << "Writing execution trace to " << traceWriter.outputPath() << "...\n";
+        artifacts.run([&] {
+            if (options.streamTrace)
+                trace.flushStream();
+            else
+                traceWriter.write(trace);
+            traceWriter.finish();
+            return traceWriter.ok();
+        }, traceWriter.outputPath());
+
+        if (states) {
+            cout << "Writing variable states to " << options.traceOutput.basePath << ".states.json...\n";
+            artifacts.write(options.traceOutput.basePath + ".states.json", states->toJson().dump());
+        }
 
         cout << "Generating symbol table...\n";
-        // Write symbol table
-        json symtab = json::array();
-        for (const auto& entry : symbolTable) {
-            json row;
-            row["name"] = entry.name;
-            row["type"] = entry.type;
-            row["scope"] = entry.scope;
-            if (entry.hasValue)
-                row["value"] = entry.value;
-            symtab.push_back(row);
+        artifacts.write("symbol_table.json", symbolTableToJson(symbolTable).dump(4));
+
+        if (options.bundle) {
+            uint32_t flags = (options.spans ? uint32_t{kBundleSpans} : 0u) |
+                             (options.compactTree ? uint32_t{kBundleCompactTree} : 0u) |
+                             (options.traceOutput.values ? uint32_t{kBundleValues} : 0u) |
+                             (options.treeSchema == TreeSchema::Dictionary ? uint32_t{kBundleDictionaryTree} : 0u);
+            cout << "Bundling tree, trace and symbol table into artifacts.bundle...\n";
+            artifacts.produce("artifacts.bundle", [&](const string& path) {
+                return writeArtifactBundle(path, tree, trace, symbolTable, flags);
+            });
+        }
+
+        bool written = artifacts.wait();
+        if (written && options.hashCons) {
+            // Every other output is written, so the DAG can consume the tree
+            cout << "Hash-consing parse tree into tree.dag.json...\n";
+            NodeInterner interner;
+            const SharedNode* dagRoot = interner.intern(std::move(tree));
+            artifacts.produce("tree.dag.json", [&](const string& path) {
+                return writeSharedJson(dagRoot, interner, path);
+            });
+            written = artifacts.wait();
+            cout << "Shared " << interner.treeNodeCount() << " nodes as "
+                 << interner.uniqueNodes().size() << " unique nodes.\n";
+        }
+        if (!written) {
+            for (const auto& failure : artifacts.failures())
+                cerr << "Error: " << failure << endl;
+            return 1;
         }
-        ofstream symtabOut("symbol_table.json");
-        symtabOut << symtab.dump(4);
-        cout << "Symbol table written successfully.\n\n";
+        cout << "Output files written (" << artifacts.backend() << ").\n\n";
 
         cout << "All tasks completed successfully!\n";
         cout << "\nOutput files generated:\n";
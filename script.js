@@ -1,10 +1,134 @@
-Promise.all([
-    fetch('tree.json').then(res => res.json()),
-    fetch('trace.json').then(res => res.json())
-]).then(([treeData, traceData]) => {
-    renderTree(treeData, traceData);
+Promise.all([loadLayout(), loadTrace()]).then(([layout, traceData]) => {
+    if (layout)
+        renderTiledTree(layout, traceData);
+    else
+        fetch('tree.json').then(res => res.json()).then(decodeTree).then(treeData => renderTree(treeData, traceData));
 });
 
+// A long trace may be split into chunks listed in trace.manifest.json
+// (--trace-chunk-events); chunks are only fetched when stepping reaches
+// them.
+const traceChunks = new Map();
+
+function parseNdjson(text) {
+    return text.split('\n').filter(line => line.length > 0).map(line => JSON.parse(line));
+}
+
+function loadTraceChunk(manifest, index) {
+    if (!traceChunks.has(index)) {
+        const chunk = manifest.chunks[index];
+        traceChunks.set(index, fetch(chunk.file).then(res =>
+            manifest.format === 'ndjson' ? res.text().then(parseNdjson) : res.json()));
+    }
+    return traceChunks.get(index);
+}
+
+// A folded trace (--fold-trace) writes repeated segments as
+// {"repeat": n, "events": [...]}, possibly nested; expanding is lossless.
+// Throws on a block of any other shape.
+function expandTrace(events, out = []) {
+    if (!Array.isArray(events))
+        throw new Error('Folded trace events must be an array');
+    for (const item of events) {
+        if (item === null || typeof item !== 'object')
+            throw new Error('Trace event is not an object');
+        if (item.repeat !== undefined) {
+            if (!Number.isInteger(item.repeat) || item.repeat < 0 || item.repeat > 0xffffffff)
+                throw new Error('Folded block has an invalid repeat count');
+            if (item.events === undefined)
+                throw new Error('Folded block has no events');
+            for (let r = 0; r < item.repeat; r++)
+                expandTrace(item.events, out);
+        } else {
+            out.push(item);
+        }
+    }
+    return out;
+}
+
+// Trace events by step: `length`, `event(i)` (undefined until its chunk
+// is loaded) and `load(i)`, which resolves once event(i) is available.
+function eventSource(events, note = '') {
+    return { length: events.length, note, event: i => events[i], load: () => Promise.resolve() };
+}
+
+function chunkedSource(manifest) {
+    const loaded = new Map();   // chunk index -> events
+    const chunkOf = i => manifest.chunks.findIndex(c => i >= c.first && i < c.first + c.count);
+    return {
+        length: manifest.events,
+        note: '',
+        event: i => {
+            const c = chunkOf(i);
+            const events = loaded.get(c);
+            return events ? events[i - manifest.chunks[c].first] : undefined;
+        },
+        load: i => {
+            const c = chunkOf(i);
+            return c < 0 ? Promise.resolve() : loadTraceChunk(manifest, c).then(events => { loaded.set(c, events); });
+        }
+    };
+}
+
+// trace.manifest.json, trace.json (folded or not) or trace.ndjson. The
+// columnar format (trace.columns) is for tools and is not read here; the
+// tree is still drawn, without trace stepping. Each run deletes the trace
+// files of the formats it did not write, so at most one of these exists.
+function loadTrace() {
+    return fetch('trace.manifest.json').then(res => {
+        if (res.ok)
+            return res.json().then(chunkedSource);
+        return fetch('trace.json').then(res => {
+            if (res.ok)
+                return res.json().then(events => {
+                    try {
+                        return eventSource(expandTrace(events));
+                    } catch (e) {
+                        return eventSource([], 'trace.json: ' + e.message);
+                    }
+                });
+            return fetch('trace.ndjson').then(res => {
+                if (res.ok)
+                    return res.text().then(text => eventSource(parseNdjson(text)));
+                return eventSource([], 'No trace.json or trace.ndjson; columnar traces cannot be shown');
+            });
+        });
+    });
+}
+
+// tree.json written with --tree-schema dictionary carries "version": 2 and
+// lists nodes in preorder as [prefix, string, childCount] triples over two
+// label tables; rebuild the nested objects d3.hierarchy expects.
+function decodeTree(data) {
+    if (data.version === undefined)
+        return data;
+    if (data.version !== 2)
+        throw new Error(`Unsupported tree.json version ${data.version}`);
+    const nodes = data.nodes;
+    const open = [];    // ancestors still waiting for children
+    let root = null;
+    for (let id = 0; id < nodes.length / 3; id++) {
+        const node = {
+            id,
+            name: data.prefixes[nodes[3 * id]] + data.strings[nodes[3 * id + 1]],
+            children: []
+        };
+        if (data.spans)
+            node.span = [data.spans[2 * id], data.spans[2 * id + 1]];
+        if (open.length === 0) {
+            root = node;
+        } else {
+            const parent = open[open.length - 1];
+            parent.node.children.push(node);
+            if (--parent.remaining === 0)
+                open.pop();
+        }
+        if (nodes[3 * id + 2] > 0)
+            open.push({ node, remaining: nodes[3 * id + 2] });
+    }
+    return root;
+}
+
 // Dark theme color palette
 function getNodeColor(label) {
     if (label.startsWith("Function")) return "url(#func-gradient)";
@@ -22,7 +146,15 @@ function getNodeColor(label) {
     return "#495057";
 }
 
-function renderTree(treeData, traceData) {
+// Highlighted circle of the current trace step; the step and the zoom
+// survive redrawing the tree after a collapsed subtree is expanded
+let highlighted = null;
+let traceStep = -1;
+let canvasTransform = null;
+
+// Shared SVG setup: dark background, gradient, zoom. Drawing goes into the
+// returned `g`, which keeps the margin inside the zoomed group.
+function createCanvas(onZoom) {
     const margin = { top: 80, right: 120, bottom: 10, left: 120 };
     const width = 1800 - margin.left - margin.right;
     const height = 1400 - margin.top - margin.bottom;
@@ -55,16 +187,111 @@ function renderTree(treeData, traceData) {
         .attr("offset", d => d.offset)
         .attr("stop-color", d => d.color);
 
-    const g = svg.append("g")
+    const zoomed = svg.append("g");
+    const g = zoomed.append("g")
         .attr("transform", `translate(${margin.left},${margin.top})`);
 
-    svg.call(
-        d3.zoom()
-            .scaleExtent([0.1, 3])
-            .on("zoom", (event) => {
-                g.attr("transform", event.transform);
-            })
-    );
+    const zoom = d3.zoom()
+        .scaleExtent([0.1, 3])
+        .on("zoom", (event) => {
+            canvasTransform = event.transform;
+            zoomed.attr("transform", event.transform);
+            if (onZoom)
+                onZoom(event.transform);
+        });
+    svg.call(zoom);
+
+    // Part of `g`'s coordinate space currently on screen
+    function visibleArea(transform) {
+        return {
+            x0: -transform.x / transform.k - margin.left,
+            x1: (width + margin.left + margin.right - transform.x) / transform.k - margin.left,
+            y0: -transform.y / transform.k - margin.top,
+            y1: (height + margin.top + margin.bottom - transform.y) / transform.k - margin.top
+        };
+    }
+
+    return { svg, g, zoom, width, height, margin, visibleArea };
+}
+
+function appendNodeMarks(node, name, isParent) {
+    node.append('circle')
+        .attr('r', 14)
+        .attr('fill', d => getNodeColor(name(d)))
+        .attr('stroke', '#f1faee')
+        .attr('stroke-width', 2)
+        .style('filter', 'drop-shadow(0 2px 8px rgba(0,0,0,0.25))')
+        .on('mouseover', function () {
+            d3.select(this)
+                .attr('stroke', '#ffd166')
+                .attr('stroke-width', 3);
+        })
+        .on('mouseout', function () {
+            if (highlighted && highlighted.node() === this)
+                return;
+            d3.select(this)
+                .attr('stroke', '#f1faee')
+                .attr('stroke-width', 2);
+        });
+
+    node.append('text')
+        .attr('dy', 5)
+        .attr('y', d => isParent(d) ? -20 : 20) // place text above parent nodes, below leaves
+        .attr('text-anchor', 'middle')
+        .style('font-size', '13px')
+        .style('font-family', '"Segoe UI", Roboto, sans-serif')
+        .style('fill', '#f1faee')
+        .text(d => name(d));
+}
+
+// Left / right arrows step through the trace, highlighting the node each
+// event names. Returns a function that re-applies the highlight after the
+// drawn nodes change.
+function attachTraceStepping(traceData, circleFor) {
+    function describe(event) {
+        const detail = event.function || event.variable || event.branch || event.limit || '';
+        const value = event.value !== undefined ? ` = ${event.value}` : '';
+        return `${event.action} ${detail}${value}`;
+    }
+
+    function highlight() {
+        if (highlighted)
+            highlighted.attr('stroke', '#f1faee').attr('stroke-width', 2);
+        const event = traceStep >= 0 ? traceData.event(traceStep) : null;
+        highlighted = event && event.node !== undefined ? circleFor(event.node) || null : null;
+        if (highlighted)
+            highlighted.attr('stroke', '#ff6f61').attr('stroke-width', 5);
+    }
+
+    function showStep(index) {
+        if (traceData.length === 0)
+            return;
+        const step = Math.max(0, Math.min(index, traceData.length - 1));
+        traceStep = step;
+        traceData.load(step).then(() => {
+            if (step !== traceStep)
+                return;     // stepped on while the chunk was loading
+            highlight();
+            d3.select('#branch-info').text(`Step ${step + 1}/${traceData.length}: ${describe(traceData.event(step))}`);
+        });
+    }
+
+    d3.select('body').on('keydown', (event) => {
+        if (event.key === 'ArrowRight')
+            showStep(traceStep + 1);
+        else if (event.key === 'ArrowLeft')
+            showStep(traceStep - 1);
+    });
+    if (traceData.note)
+        d3.select('#branch-info').text(traceData.note);
+    highlight();
+    return highlight;
+}
+
+function renderTree(treeData, traceData) {
+    const { svg, g, zoom, width, height } = createCanvas();
+    if (canvasTransform)
+        svg.call(zoom.transform, canvasTransform);
 
     const root = d3.hierarchy(treeData);
 
@@ -96,31 +323,129 @@ function renderTree(treeData, traceData) {
         .attr('class', 'node')
         .attr('transform', d => `translate(${d.x},${d.y})`);
 
-    node.append('circle')
-        .attr('r', 14)
-        .attr('fill', d => getNodeColor(d.data.name))
-        .attr('stroke', '#f1faee')
-        .attr('stroke-width', 2)
-        .style('filter', 'drop-shadow(0 2px 8px rgba(0,0,0,0.25))')
-        .on('mouseover', function () {
-            d3.select(this)
-                .attr('stroke', '#ffd166')
-                .attr('stroke-width', 3);
-        })
-        .on('mouseout', function () {
-            d3.select(this)
-                .attr('stroke', '#f1faee')
-                .attr('stroke-width', 2);
+    // Stubs of a level-of-detail tree.json (--tree-depth / --tree-nodes)
+    // show how much they hide; clicking one loads tree.parts/<id>.json
+    // in its place. A stub with "from" stands for the remaining children
+    // of its parent, loaded from tree.parts/<id>-<from>.json.
+    appendNodeMarks(node, d => d.data.collapsed ? `${d.data.name} (+${d.data.collapsed})` : d.data.name,
+        d => d.children || d.data.collapsed);
+    node.filter(d => d.data.collapsed)
+        .select('circle')
+        .attr('stroke-dasharray', '4 3')
+        .on('click', (event, d) => {
+            const page = d.data.from !== undefined;
+            const file = page ? `${d.data.id}-${d.data.from}` : d.data.id;
+            fetch(`tree.parts/${file}.json`).then(res => res.json()).then(part => {
+                if (page) {
+                    const siblings = d.parent.data.children;
+                    siblings.splice(siblings.indexOf(d.data), 1, ...part.children);
+                } else {
+                    d.data.children = part.children;
+                    delete d.data.collapsed;
+                }
+                renderTree(treeData, traceData);
+            });
         });
 
-    node.append('text')
-        .attr('dy', 5)
-        .attr('y', d => d.children ? -20 : 20) // place text above parent nodes, below leaves
-        .attr('text-anchor', 'middle')
-        .style('font-size', '13px')
-        .style('font-family', '"Segoe UI", Roboto, sans-serif')
-        .style('fill', '#f1faee')
-        .text(d => d.data.name);
+    // Node ids are dense preorder indices and every trace event names the
+    // node that produced it, so finding the executing node is a lookup.
+    const circlesById = [];
+    node.filter(d => d.data.from === undefined).each(function (d) {
+        circlesById[d.data.id] = d3.select(this).select('circle');
+    });
+
+    attachTraceStepping(traceData, id => circlesById[id]);
+}
+
+// With --tree-layout the C++ side has already laid the tree out and split
+// the nodes into grid tiles (tree.layout.json); only the tiles in view are
+// fetched and drawn, so the page stays responsive however large the tree.
+// Tile records are [id, x, depth, parent id, parent x, child count, name].
+const kLayoutScaleX = 40;       // px per layout unit
+const kLayoutScaleY = 110;      // px per tree level
+const kMaxVisibleTiles = 48;
+const layoutTiles = new Map();
+
+function loadLayout() {
+    return fetch('tree.layout.json').then(res => res.ok ? res.json() : null);
+}
+
+function loadLayoutTile(layout, key) {
+    if (!layoutTiles.has(key))
+        layoutTiles.set(key, fetch(`${layout.directory}/${key}.json`).then(res => res.json()));
+    return layoutTiles.get(key);
+}
+
+function renderTiledTree(layout, traceData) {
+    const present = new Set(layout.tiles.map(([column, row]) => `${column}_${row}`));
+    const canvas = createCanvas(transform => update(transform));
+    const links = canvas.g.append('g');
+    const nodes = canvas.g.append('g');
+    const circlesById = new Map();
+    const refreshHighlight = attachTraceStepping(traceData, id => circlesById.get(id));
+    const linkPath = d3.linkVertical().x(p => p[0]).y(p => p[1]);
+    let generation = 0;
+
+    function update(transform) {
+        const area = canvas.visibleArea(transform);
+        const tileWidth = layout.tileWidth * kLayoutScaleX;
+        const tileHeight = layout.tileDepth * kLayoutScaleY;
+        const keys = [];
+        // Labels hang 20px above a node, so take one extra row from above
+        const rowStart = Math.max(0, Math.floor((area.y0 - kLayoutScaleY) / tileHeight));
+        const rowEnd = Math.floor(area.y1 / tileHeight);
+        const columnStart = Math.max(0, Math.floor(area.x0 / tileWidth));
+        const columnEnd = Math.floor(area.x1 / tileWidth);
+        for (let row = rowStart; row <= rowEnd; row++) {
+            for (let column = columnStart; column <= columnEnd && keys.length <= kMaxVisibleTiles; column++) {
+                if (present.has(`${column}_${row}`))
+                    keys.push(`${column}_${row}`);
+            }
+        }
+        const current = ++generation;
+        if (keys.length > kMaxVisibleTiles) {
+            draw([]);
+            d3.select('#branch-info').text(`${layout.nodes} nodes: zoom in to see them`);
+            return;
+        }
+        Promise.all(keys.map(key => loadLayoutTile(layout, key))).then(tiles => {
+            if (current === generation)
+                draw(tiles.flat());
+        });
+    }
+
+    function draw(records) {
+        links.selectAll('path')
+            .data(records.filter(r => r[3] >= 0), r => r[0])
+            .join('path')
+            .attr('class', 'link')
+            .attr('fill', 'none')
+            .attr('stroke', '#353945')
+            .attr('stroke-width', 1.5)
+            .attr('stroke-opacity', 0.85)
+            .attr('d', r => linkPath({
+                source: [r[4] * kLayoutScaleX, (r[2] - 1) * kLayoutScaleY],
+                target: [r[1] * kLayoutScaleX, r[2] * kLayoutScaleY]
+            }));
+
+        nodes.selectAll('g.node')
+            .data(records, r => r[0])
+            .join(enter => {
+                const node = enter.append('g').attr('class', 'node');
+                appendNodeMarks(node, r => r[6], r => r[5] > 0);
+                return node;
+            })
+            .attr('transform', r => `translate(${r[1] * kLayoutScaleX},${r[2] * kLayoutScaleY})`);
+
+        circlesById.clear();
+        nodes.selectAll('g.node').each(function (r) {
+            circlesById.set(r[0], d3.select(this).select('circle'));
+        });
+        refreshHighlight();
+    }
 
-    // No animation/highlighting for now
+    // Start with the root centred at the top
+    const viewWidth = canvas.width + canvas.margin.left + canvas.margin.right;
+    canvas.svg.call(canvas.zoom.transform,
+        d3.zoomIdentity.translate(viewWidth / 2 - canvas.margin.left - layout.root * kLayoutScaleX, 0));
 }
@@ -0,0 +1,386 @@
+#include "ArtifactBundle.h"
+#include <cstring>
+#include "ArtifactWriter.h"
+#include "BufferedSink.h"
+#include "TraceWriter.h"
+#include "TreeWriter.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr uint32_t kSectionCount = 5;
+
+// Record size per BundleSectionKind
+constexpr uint32_t kRecordSizes[kSectionCount] = {sizeof(BundleString), 1, sizeof(BundleNode),
+                                                  sizeof(TraceEvent), sizeof(BundleSymbol)};
+
+uint64_t align8(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+template <typename T>
+std::string_view bytesOf(const T* data, size_t count) {
+    return std::string_view(reinterpret_cast<const char*>(data), count * sizeof(T));
+}
+
+void flattenTree(const Node& node, uint32_t parent, StringPool& strings, std::vector<BundleNode>& out) {
+    uint32_t index = static_cast<uint32_t>(out.size());
+    out.push_back({strings.intern(node.label), parent, static_cast<uint32_t>(node.children.size()), 0,
+                   node.offset, node.length});
+    for (const auto& child : node.children)
+        flattenTree(child, index, strings, out);
+    out[index].subtreeSize = static_cast<uint32_t>(out.size()) - index;
+}
+
+void buildTree(const ArtifactBundle& bundle, uint32_t id, Node& node) {
+    const BundleNode& record = bundle.nodes()[id];
+    node.label = std::string(bundle.string(record.label));
+    node.offset = record.offset;
+    node.length = record.length;
+    node.id = id;
+    // Children are bounded by the subtree, even if childCount disagrees
+    uint32_t end = id + record.subtreeSize;
+    uint32_t child = id + 1;
+    for (uint32_t i = 0; i < record.childCount && child < end; ++i) {
+        node.children.emplace_back();
+        buildTree(bundle, child, node.children.back());
+        child = bundle.nextSibling(child);
+    }
+}
+
+// Maps `path` read-only; returns nullptr on failure
+const char* mapFile(const std::string& path, size_t& size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+    LARGE_INTEGER length;
+    const char* base = nullptr;
+    if (GetFileSizeEx(file, &length) && length.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            base = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping);
+        }
+        size = static_cast<size_t>(length.QuadPart);
+    }
+    CloseHandle(file);
+    return base;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat info;
+    const char* base = nullptr;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            base = static_cast<const char*>(mapped);
+            size = static_cast<size_t>(info.st_size);
+        }
+    }
+    close(fd);
+    return base;
+#endif
+}
+
+} // namespace
+
+bool writeArtifactBundle(const std::string& path, const Node& tree, const TraceBuffer& trace,
+                         const std::vector<SymbolEntry>& symbols, uint32_t flags) {
+    StringPool strings;
+    std::vector<BundleNode> nodes;
+    flattenTree(tree, kNoNode, strings, nodes);
+
+    // Trace names are re-interned into the shared table on first use
+    std::vector<uint32_t> traceNames(trace.names.strings.size(), kNoName);
+    std::vector<TraceEvent> events;
+    events.reserve(trace.retained());
+    for (size_t i = 0; i < trace.retained(); ++i) {
+        TraceEvent event = trace[i];
+        if (event.name != kNoName) {
+            uint32_t& id = traceNames[event.name];
+            if (id == kNoName)
+                id = strings.intern(trace.names[event.name]);
+            event.name = id;
+        }
+        events.push_back(event);
+    }
+
+    std::vector<BundleSymbol> symbolRecords;
+    symbolRecords.reserve(symbols.size());
+    for (const auto& entry : symbols) {
+        BundleSymbol record{};
+        record.name = strings.intern(entry.name);
+        record.type = strings.intern(entry.type);
+        record.scope = strings.intern(entry.scope);
+        record.value = entry.value;
+        record.hasValue = entry.hasValue ? 1 : 0;
+        symbolRecords.push_back(record);
+    }
+
+    std::vector<BundleString> stringIndex;
+    uint64_t stringBytes = 0;
+    for (const auto& s : strings.strings) {
+        stringIndex.push_back({static_cast<uint32_t>(stringBytes), static_cast<uint32_t>(s.size())});
+        stringBytes += s.size();
+    }
+    if (stringBytes > UINT32_MAX)
+        return false;
+
+    BundleSection directory[kSectionCount] = {
+        {BundleSectionKind::StringIndex, sizeof(BundleString), 0, stringIndex.size()},
+        {BundleSectionKind::StringBytes, 1, 0, stringBytes},
+        {BundleSectionKind::Nodes, sizeof(BundleNode), 0, nodes.size()},
+        {BundleSectionKind::Events, sizeof(TraceEvent), 0, events.size()},
+        {BundleSectionKind::Symbols, sizeof(BundleSymbol), 0, symbolRecords.size()},
+    };
+    uint64_t offset = sizeof(BundleHeader) + sizeof(directory);
+    for (auto& section : directory) {
+        section.offset = align8(offset);
+        offset = section.offset + section.count * section.elementSize;
+    }
+
+    BundleHeader header{};
+    std::memcpy(header.magic, kBundleMagic, sizeof(header.magic));
+    header.version = kBundleVersion;
+    header.flags = flags;
+    header.sectionCount = kSectionCount;
+    header.byteOrder = kBundleByteOrder;
+    header.fileSize = offset;
+
+    BufferedSink sink(path);
+    sink.write(bytesOf(&header, 1));
+    sink.write(bytesOf(directory, kSectionCount));
+    auto pad = [&](size_t i) {
+        static const char zeros[8] = {};
+        sink.write(std::string_view(zeros, directory[i].offset - sink.bytesWritten()));
+    };
+    pad(0);
+    sink.write(bytesOf(stringIndex.data(), stringIndex.size()));
+    pad(1);
+    for (const auto& s : strings.strings)
+        sink.write(s);
+    pad(2);
+    sink.write(bytesOf(nodes.data(), nodes.size()));
+    pad(3);
+    sink.write(bytesOf(events.data(), events.size()));
+    pad(4);
+    sink.write(bytesOf(symbolRecords.data(), symbolRecords.size()));
+    sink.close();
+    return sink.ok();
+}
+
+ArtifactBundle::ArtifactBundle(ArtifactBundle&& other) noexcept {
+    *this = std::move(other);
+}
+
+ArtifactBundle& ArtifactBundle::operator=(ArtifactBundle&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        base = other.base;
+        mappedSize = other.mappedSize;
+        stringIndex = other.stringIndex;
+        stringBytes = other.stringBytes;
+        nodeArray = other.nodeArray;
+        eventArray = other.eventArray;
+        symbolArray = other.symbolArray;
+        other.base = nullptr;
+        other.mappedSize = 0;
+    }
+    return *this;
+}
+
+ArtifactBundle::~ArtifactBundle() {
+    unmap();
+}
+
+void ArtifactBundle::unmap() {
+    if (!base)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+#else
+    munmap(const_cast<char*>(base), mappedSize);
+#endif
+    base = nullptr;
+}
+
+Result<ArtifactBundle> openArtifactBundle(const std::string& path) {
+    Result<ArtifactBundle> result;
+    auto fail = [&](const std::string& message) {
+        result.diagnostics.push_back({path + ": " + message});
+        return std::move(result);
+    };
+
+    ArtifactBundle& bundle = result.value;
+    bundle.base = mapFile(path, bundle.mappedSize);
+    if (!bundle.base)
+        return fail("cannot map file");
+    if (bundle.mappedSize < sizeof(BundleHeader))
+        return fail("not an artifact bundle");
+    const BundleHeader& header = bundle.header();
+    if (std::memcmp(header.magic, kBundleMagic, sizeof(kBundleMagic)) != 0)
+        return fail("not an artifact bundle");
+    if (header.byteOrder != kBundleByteOrder)
+        return fail("bundle was written with a different byte order");
+    if (header.version != kBundleVersion)
+        return fail("unsupported bundle version " + std::to_string(header.version));
+    if (header.fileSize != bundle.mappedSize)
+        return fail("bundle is truncated");
+    if (header.sectionCount > (bundle.mappedSize - sizeof(BundleHeader)) / sizeof(BundleSection))
+        return fail("corrupt section directory");
+
+    const auto* directory = reinterpret_cast<const BundleSection*>(bundle.base + sizeof(BundleHeader));
+    bool found[kSectionCount] = {};
+    uint64_t stringBytes = 0;
+    for (uint32_t i = 0; i < header.sectionCount; ++i) {
+        const BundleSection& section = directory[i];
+        uint32_t kind = static_cast<uint32_t>(section.kind);
+        if (kind >= kSectionCount)
+            continue;   // sections added by later versions
+        if (section.offset % 8 || section.offset > bundle.mappedSize || section.elementSize == 0 ||
+            section.count > (bundle.mappedSize - section.offset) / section.elementSize)
+            return fail("section " + std::to_string(i) + " is out of bounds");
+        if (section.elementSize != kRecordSizes[kind])
+            return fail("section " + std::to_string(i) + " has unexpected record size");
+        if (found[kind])
+            return fail("duplicate section " + std::to_string(i));
+        found[kind] = true;
+
+        const char* data = bundle.base + section.offset;
+        switch (section.kind) {
+        case BundleSectionKind::StringIndex:
+            bundle.stringIndex = {reinterpret_cast<const BundleString*>(data), section.count};
+            break;
+        case BundleSectionKind::StringBytes:
+            bundle.stringBytes = data;
+            stringBytes = section.count;
+            break;
+        case BundleSectionKind::Nodes:
+            bundle.nodeArray = {reinterpret_cast<const BundleNode*>(data), section.count};
+            break;
+        case BundleSectionKind::Events:
+            bundle.eventArray = {reinterpret_cast<const TraceEvent*>(data), section.count};
+            break;
+        case BundleSectionKind::Symbols:
+            bundle.symbolArray = {reinterpret_cast<const BundleSymbol*>(data), section.count};
+            break;
+        }
+    }
+    for (bool present : found) {
+        if (!present)
+            return fail("missing section");
+    }
+
+    // Bounds checks, so accessors never need them
+    for (const auto& s : bundle.stringIndex) {
+        if (uint64_t(s.offset) + s.length > stringBytes)
+            return fail("string out of bounds");
+    }
+    size_t strings = bundle.stringCount();
+    size_t nodes = bundle.nodeArray.size();
+    for (size_t i = 0; i < nodes; ++i) {
+        const BundleNode& node = bundle.nodeArray[i];
+        if (node.label >= strings || node.subtreeSize == 0 || node.subtreeSize > nodes - i ||
+            node.childCount >= node.subtreeSize)
+            return fail("node " + std::to_string(i) + " is corrupt");
+    }
+    for (size_t i = 0; i < bundle.eventArray.size(); ++i) {
+        const TraceEvent& event = bundle.eventArray[i];
+        if (static_cast<uint32_t>(event.action) >= kTraceActionCount)
+            return fail("trace event " + std::to_string(i) + " has an unknown action");
+        if (event.name >= strings && (traceEventHasName(event.action) || event.name != kNoName))
+            return fail("trace event " + std::to_string(i) + " names an unknown string");
+    }
+    for (const auto& symbol : bundle.symbolArray) {
+        if (symbol.name >= strings || symbol.type >= strings || symbol.scope >= strings)
+            return fail("symbol names an unknown string");
+    }
+    return result;
+}
+
+Node bundleToTree(const ArtifactBundle& bundle) {
+    Node root;
+    if (bundle.nodes().size())
+        buildTree(bundle, 0, root);
+    return root;
+}
+
+void bundleToTrace(const ArtifactBundle& bundle, TraceBuffer& buffer) {
+    buffer.clear();
+    buffer.names = StringPool();
+    // Events keep their string ids, so the pool mirrors the table exactly
+    for (uint32_t i = 0; i < bundle.stringCount(); ++i) {
+        buffer.names.strings.emplace_back(bundle.string(i));
+        buffer.names.ids.emplace(buffer.names.strings.back(), i);
+    }
+    for (const auto& event : bundle.events())
+        buffer.push(event);
+}
+
+std::vector<SymbolEntry> bundleToSymbols(const ArtifactBundle& bundle) {
+    std::vector<SymbolEntry> symbols;
+    symbols.reserve(bundle.symbols().size());
+    for (const auto& symbol : bundle.symbols()) {
+        symbols.push_back({std::string(bundle.string(symbol.name)), std::string(bundle.string(symbol.type)),
+                           std::string(bundle.string(symbol.scope)), symbol.value, symbol.hasValue != 0});
+    }
+    return symbols;
+}
+
+int runUnbundle(const std::string& path, std::ostream& out, bool atomic) {
+    auto opened = openArtifactBundle(path);
+    if (!opened.ok()) {
+        for (const auto& d : opened.diagnostics)
+            out << "Error: " << d.message << "\n";
+        return 1;
+    }
+    const ArtifactBundle& bundle = opened.value;
+
+    TreeWriterOptions treeOutput;
+    treeOutput.pretty = !(bundle.flags() & kBundleCompactTree);
+    treeOutput.spans = (bundle.flags() & kBundleSpans) != 0;
+    if (bundle.flags() & kBundleDictionaryTree)
+        treeOutput.schema = TreeSchema::Dictionary;
+    Node tree = bundleToTree(bundle);
+
+    TraceBuffer events;
+    bundleToTrace(bundle, events);
+    TraceWriterOptions traceOutput;
+    traceOutput.values = (bundle.flags() & kBundleValues) != 0;
+    traceOutput.atomic = atomic;
+    TraceWriter traceWriter(traceOutput);
+
+    // Written the way the run that made the bundle writes them
+    ArtifactWriter artifacts(atomic);
+    artifacts.produce("tree.json", [&](const std::string& staged) {
+        return writeTreeFile(tree, staged, treeOutput);
+    });
+    artifacts.run([&] {
+        traceWriter.write(events);
+        traceWriter.finish();
+        return traceWriter.ok();
+    }, traceWriter.outputPath());
+    artifacts.write("symbol_table.json", symbolTableToJson(bundleToSymbols(bundle)).dump(4));
+    bool ok = artifacts.wait();
+
+    out << path << ": " << bundle.nodes().size() << " nodes, " << bundle.events().size() << " events, "
+        << bundle.symbols().size() << " symbols\n";
+    if (!ok) {
+        out << "Error: could not write the JSON files\n";
+        return 1;
+    }
+    out << "Wrote tree.json, trace.json and symbol_table.json.\n";
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include "ArtifactWriter.h"
+#include <cstdio>
+#include <filesystem>
+#include "AsyncFile.h"
+
+ArtifactWriter::ArtifactWriter(bool atomic, unsigned threads) : atomic(atomic) {
+    if (threads == 0)
+        threads = 1;
+    for (unsigned i = 0; i < threads; ++i)
+        workers.emplace_back([this] { workerLoop(); });
+}
+
+ArtifactWriter::~ArtifactWriter() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+const char* ArtifactWriter::backend() const {
+    return ioUringAvailable() ? "io_uring" : "threads";
+}
+
+std::string ArtifactWriter::stagingPath(const std::string& path) const {
+    return atomic ? path + ".tmp" : path;
+}
+
+bool ArtifactWriter::commit(const std::string& staged, const std::string& path) {
+    if (staged == path)
+        return true;
+    std::error_code error;
+    std::filesystem::rename(staged, path, error);
+    if (error) {
+        std::remove(staged.c_str());
+        return false;
+    }
+    return true;
+}
+
+void ArtifactWriter::fail(const std::string& message) {
+    std::lock_guard<std::mutex> lock(mutex);
+    failed.push_back(message);
+}
+
+void ArtifactWriter::enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(job));
+        ++pending;
+    }
+    available.notify_one();
+}
+
+void ArtifactWriter::workerLoop() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return;
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        job();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --pending;
+        }
+        idle.notify_all();
+    }
+}
+
+void ArtifactWriter::produce(const std::string& path, Producer producer) {
+    enqueue([this, path, producer = std::move(producer)] {
+        std::string staged = stagingPath(path);
+        bool ok = false;
+        try {
+            ok = producer(staged);
+        }
+        catch (const std::exception& e) {
+            fail(path + ": " + e.what());
+            std::remove(staged.c_str());
+            return;
+        }
+        if (!ok && staged != path)
+            std::remove(staged.c_str());
+        if (!ok || !commit(staged, path))
+            fail(path + ": write failed");
+    });
+}
+
+void ArtifactWriter::write(const std::string& path, std::string contents) {
+    produce(path, [contents = std::move(contents)](const std::string& staged) mutable {
+        AsyncFile file(staged);
+        file.write(std::move(contents));
+        return file.close();
+    });
+}
+
+void ArtifactWriter::run(std::function<bool()> job, const std::string& description) {
+    enqueue([this, job = std::move(job), description] {
+        bool ok = false;
+        try {
+            ok = job();
+        }
+        catch (const std::exception& e) {
+            fail(description + ": " + e.what());
+            return;
+        }
+        if (!ok)
+            fail(description + ": write failed");
+    });
+}
+
+bool ArtifactWriter::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return pending == 0; });
+    return failed.empty();
+}
@@ -0,0 +1,378 @@
+#include "AsyncFile.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// Only the kernel header is needed: the ring is driven with the raw system
+// calls, so there is no liburing dependency
+#if defined(__NR_io_uring_setup) && defined(IO_URING_OP_SUPPORTED)
+#define ASYNC_FILE_IO_URING 1
+#else
+#define ASYNC_FILE_IO_URING 0
+#endif
+
+namespace {
+
+std::atomic<bool> ioUringEnabled{true};
+
+// Buffers one file may have queued before write() waits for the oldest
+constexpr unsigned kMaxQueuedPerFile = 4;
+// Spare buffers a file keeps for reuse
+constexpr size_t kMaxSpares = 2;
+// The kernel caps a single write a little below 2 GiB
+constexpr size_t kMaxWrite = size_t(1) << 30;
+
+} // namespace
+
+struct AsyncFile::Pending {
+    AsyncFile* file;
+    std::string buffer;
+    size_t size;        // bytes of buffer to write
+    size_t done;        // bytes written so far
+    uint64_t offset;    // file offset of buffer[0]
+};
+
+#if ASYNC_FILE_IO_URING
+
+// One thread's io_uring instance. Files keep a reference to it, so it may
+// also be used from other threads; every operation takes the mutex. Each
+// io_uring_enter submits the whole submission queue, so a free slot only
+// needs fewer writes in flight than entries; the completion queue is twice
+// as long and cannot overflow.
+class IoRing {
+public:
+    static std::shared_ptr<IoRing> forThisThread();
+    static bool probe();
+
+    ~IoRing();
+
+    // Queues a write of pending->buffer, first waiting while its file or
+    // the ring is full; false if it could not be submitted. On success a
+    // spare buffer of the file is moved into `spare`, if it has one.
+    bool submit(AsyncFile::Pending* pending, std::string* spare);
+    // Waits until every write queued for `file` has completed
+    void drain(AsyncFile& file);
+
+private:
+    static constexpr unsigned kEntries = 32;
+
+    std::mutex mutex;
+    int fd = -1;
+    bool broken = false;
+    unsigned entries = 0;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    void* sqeMap = MAP_FAILED;
+    size_t sqRingSize = 0, cqRingSize = 0, sqeMapSize = 0;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    std::unordered_set<AsyncFile::Pending*> inflight;
+
+    IoRing();
+    bool ok() const { return fd >= 0 && !broken; }
+    void unmap();
+    // The rest run with the mutex held
+    bool enqueue(AsyncFile::Pending* pending);
+    void waitOne();
+    void complete(AsyncFile::Pending* pending, int result);
+    void breakRing();
+};
+
+namespace {
+
+thread_local std::shared_ptr<IoRing> threadRing;
+
+template <typename T>
+T* at(void* base, unsigned offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+} // namespace
+
+IoRing::IoRing() {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd = static_cast<int>(syscall(__NR_io_uring_setup, kEntries, &params));
+    if (fd < 0)
+        return;
+    entries = params.sq_entries;
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqeMapSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    sqeMap = mmap(nullptr, sqeMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqeMap == MAP_FAILED) {
+        unmap();
+        return;
+    }
+    sqTail = at<unsigned>(sqRing, params.sq_off.tail);
+    sqMask = at<unsigned>(sqRing, params.sq_off.ring_mask);
+    sqArray = at<unsigned>(sqRing, params.sq_off.array);
+    sqes = static_cast<io_uring_sqe*>(sqeMap);
+    cqHead = at<unsigned>(cqRing, params.cq_off.head);
+    cqTail = at<unsigned>(cqRing, params.cq_off.tail);
+    cqMask = at<unsigned>(cqRing, params.cq_off.ring_mask);
+    cqes = at<io_uring_cqe>(cqRing, params.cq_off.cqes);
+}
+
+IoRing::~IoRing() {
+    // After a failure the kernel may still use the rings and the buffers
+    if (!broken)
+        unmap();
+}
+
+void IoRing::unmap() {
+    if (sqRing != MAP_FAILED)
+        munmap(sqRing, sqRingSize);
+    if (cqRing != MAP_FAILED)
+        munmap(cqRing, cqRingSize);
+    if (sqeMap != MAP_FAILED)
+        munmap(sqeMap, sqeMapSize);
+    sqRing = cqRing = sqeMap = MAP_FAILED;
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
+
+std::shared_ptr<IoRing> IoRing::forThisThread() {
+    if (!ioUringAvailable())
+        return nullptr;
+    if (!threadRing)
+        threadRing.reset(new IoRing());
+    std::lock_guard<std::mutex> lock(threadRing->mutex);
+    return threadRing->ok() ? threadRing : nullptr;
+}
+
+bool IoRing::probe() {
+    IoRing ring;
+    if (!ring.ok())
+        return false;
+    // IORING_OP_WRITE needs Linux 5.6; so does the probe itself
+    std::unique_ptr<char[]> storage(new char[sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op)]());
+    auto* ops = reinterpret_cast<io_uring_probe*>(storage.get());
+    if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PROBE, ops, 256) < 0)
+        return false;
+    return ops->last_op >= IORING_OP_WRITE && (ops->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+}
+
+bool IoRing::enqueue(AsyncFile::Pending* pending) {
+    // The queue is empty between calls, so the slot at the tail is free
+    unsigned tail = *sqTail;
+    unsigned index = tail & *sqMask;
+    io_uring_sqe& sqe = sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_WRITE;
+    sqe.fd = pending->file->fd;
+    sqe.off = pending->offset + pending->done;
+    sqe.addr = reinterpret_cast<uint64_t>(pending->buffer.data() + pending->done);
+    sqe.len = static_cast<uint32_t>(std::min(pending->size - pending->done, kMaxWrite));
+    sqe.user_data = reinterpret_cast<uint64_t>(pending);
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    for (;;) {
+        long submitted = syscall(__NR_io_uring_enter, fd, 1, 0, 0, nullptr, 0);
+        if (submitted == 1)
+            return true;
+        if (submitted < 0 && errno == EINTR)
+            continue;
+        // The entry may still sit in the queue; never enter this ring again
+        return false;
+    }
+}
+
+bool IoRing::submit(AsyncFile::Pending* pending, std::string* spare) {
+    std::lock_guard<std::mutex> lock(mutex);
+    AsyncFile& file = *pending->file;
+    while (ok() && (file.queued >= kMaxQueuedPerFile || inflight.size() >= entries))
+        waitOne();
+    if (!ok())
+        return false;
+    if (!enqueue(pending)) {
+        breakRing();
+        return false;
+    }
+    inflight.insert(pending);
+    ++file.queued;
+    if (spare && !file.spares.empty()) {
+        spare->swap(file.spares.back());
+        file.spares.pop_back();
+    }
+    return true;
+}
+
+void IoRing::drain(AsyncFile& file) {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (file.queued && ok())
+        waitOne();
+}
+
+void IoRing::waitOne() {
+    if (inflight.empty())
+        return;
+    unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE) &&
+        syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+        breakRing();
+        return;
+    }
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail && ok(); ++head) {
+        const io_uring_cqe& cqe = cqes[head & *cqMask];
+        auto* pending = reinterpret_cast<AsyncFile::Pending*>(cqe.user_data);
+        int result = cqe.res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        complete(pending, result);
+    }
+}
+
+void IoRing::complete(AsyncFile::Pending* pending, int result) {
+    if (result > 0)
+        pending->done += static_cast<size_t>(result);
+    bool progress = result > 0 || result == -EINTR || result == -EAGAIN;
+    if (progress && pending->done < pending->size) {
+        // Short write: queue the rest at the following offset
+        if (!enqueue(pending))
+            breakRing();
+        return;
+    }
+    AsyncFile& file = *pending->file;
+    if (pending->done < pending->size)
+        file.failed = true;
+    inflight.erase(pending);
+    --file.queued;
+    if (file.spares.size() < kMaxSpares)
+        file.spares.push_back(std::move(pending->buffer));
+    delete pending;
+}
+
+// The kernel may still read the buffers of writes in flight, so they are
+// leaked rather than freed; their files are reported as failed
+void IoRing::breakRing() {
+    broken = true;
+    for (AsyncFile::Pending* pending : inflight) {
+        pending->file->failed = true;
+        --pending->file->queued;
+    }
+    inflight.clear();
+}
+
+#endif // ASYNC_FILE_IO_URING
+
+bool ioUringAvailable() {
+#if ASYNC_FILE_IO_URING
+    static const bool supported = IoRing::probe();
+    return ioUringEnabled && supported;
+#else
+    return false;
+#endif
+}
+
+void setIoUringEnabled(bool enabled) {
+    ioUringEnabled = enabled;
+}
+
+AsyncFile::AsyncFile(const std::string& path, bool atomic)
+    : path(path), staged(atomic ? path + ".tmp" : path) {
+    fd = ::open(staged.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    failed = fd < 0;
+}
+
+AsyncFile::~AsyncFile() {
+    if (staged != path && fd >= 0) {
+        // Never closed, so never complete: drop the staging file
+        failed = true;
+    }
+    close();
+}
+
+bool AsyncFile::queue(std::string& bytes, size_t size, bool reuse) {
+#if ASYNC_FILE_IO_URING
+    if (!ring)
+        ring = IoRing::forThisThread();
+    if (!ring || !ioUringAvailable())
+        return false;
+    auto* pending = new Pending{this, std::string(), size, 0, offset};
+    pending->buffer.swap(bytes);
+    if (!ring->submit(pending, reuse ? &bytes : nullptr)) {
+        bytes.swap(pending->buffer);
+        delete pending;
+        return false;
+    }
+    offset += size;
+    return true;
+#else
+    (void)bytes;
+    (void)size;
+    (void)reuse;
+    return false;
+#endif
+}
+
+void AsyncFile::write(std::string& buffer, size_t size) {
+    if (!ok() || size == 0)
+        return;
+    size_t capacity = buffer.size();
+    if (queue(buffer, size, true))
+        buffer.resize(capacity);
+    else
+        writeNow(buffer.data(), size);
+}
+
+void AsyncFile::write(std::string bytes) {
+    if (ok() && !bytes.empty() && !queue(bytes, bytes.size(), false))
+        writeNow(bytes.data(), bytes.size());
+}
+
+void AsyncFile::writeNow(const char* data, size_t size) {
+    while (size && ok()) {
+        ssize_t written = pwrite(fd, data, std::min(size, kMaxWrite), static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0) {
+            failed = true;
+            return;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+}
+
+bool AsyncFile::close() {
+    if (fd < 0)
+        return ok();
+#if ASYNC_FILE_IO_URING
+    if (ring)
+        ring->drain(*this);
+#endif
+    if (::close(fd) != 0)
+        failed = true;
+    fd = -1;
+    if (staged != path) {
+        if (ok() && std::rename(staged.c_str(), path.c_str()) != 0)
+            failed = true;
+        if (!ok())
+            std::remove(staged.c_str());
+    }
+    return ok();
+}
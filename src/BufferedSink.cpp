@@ -0,0 +1,42 @@
+#include "BufferedSink.h"
+
+BufferedSink::BufferedSink(const std::string& path, bool atomic, size_t capacity)
+    : file(path, atomic), buffer(capacity, '\0') {}
+
+BufferedSink::~BufferedSink() {
+    // An atomic file is discarded unless close() was called
+    flush();
+}
+
+void BufferedSink::flush() {
+    if (used == 0)
+        return;
+    file.write(buffer, used);
+    flushed += used;
+    used = 0;
+}
+
+void BufferedSink::drain(std::string_view text) {
+    flush();
+    if (text.size() >= buffer.size()) {
+        file.write(std::string(text));
+        flushed += text.size();
+    }
+    else {
+        text.copy(&buffer[0], text.size());
+        used = text.size();
+    }
+}
+
+void BufferedSink::close() {
+    flush();
+    file.close();
+}
+
+void BufferedSink::writeJsonString(std::string_view text) {
+    writeJsonStringTo(*this, text);
+}
+
+void StringSink::writeJsonString(std::string_view s) {
+    writeJsonStringTo(*this, s);
+}
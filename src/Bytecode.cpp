@@ -0,0 +1,363 @@
+#include "Bytecode.h"
+#include "SymbolTable.h"
+#include "languages/CppSubset.h"
+
+uint32_t BytecodeProgram::intern(const std::string& name) {
+    auto it = nameIds.find(name);
+    if (it != nameIds.end())
+        return it->second;
+    uint32_t id = static_cast<uint32_t>(names.size());
+    names.push_back(name);
+    nameIds.emplace(name, id);
+    return id;
+}
+
+namespace {
+
+std::string functionName(const Node& func) {
+    for (const auto& child : func.children) {
+        if (child.label.rfind("FunctionName:", 0) == 0)
+            return child.label.substr(13);
+    }
+    return "";
+}
+
+OpCode binaryOp(const std::string& op, bool& known) {
+    known = true;
+    if (op == "+") return OpCode::Add;
+    if (op == "-") return OpCode::Sub;
+    if (op == "*") return OpCode::Mul;
+    if (op == "/") return OpCode::Div;
+    if (op == "%") return OpCode::Mod;
+    if (op == "==") return OpCode::Eq;
+    if (op == "!=") return OpCode::Ne;
+    if (op == "<") return OpCode::Lt;
+    if (op == ">") return OpCode::Gt;
+    if (op == "<=") return OpCode::Le;
+    if (op == ">=") return OpCode::Ge;
+    known = false;
+    return OpCode::Add;
+}
+
+constexpr std::string_view kStreamManipulators[] = {"endl", "ends", "flush"};
+
+// Whether a "Value: ..." names a variable, and so gets a frame slot
+bool isVariable(const std::string& value) {
+    if (value.empty() || !(cppSubset.classOf(value[0]) & CC_IdentStart))
+        return false;
+    for (char c : value) {
+        if (!(cppSubset.classOf(c) & (CC_IdentStart | CC_Digit)))
+            return false;
+    }
+    for (std::string_view manipulator : kStreamManipulators) {
+        if (value == manipulator)
+            return false;
+    }
+    return !cppSubset.keywords.contains(value);
+}
+
+// Lowers the string-labelled AST with the semantics of the old tree-walking
+// simulator, plus Increment / Decrement, which it did not execute.
+class Compiler {
+private:
+    BytecodeProgram& program;
+    std::unordered_map<std::string, uint32_t> firstByName;
+
+    // Slot resolution for the function being compiled
+    uint32_t current = 0;
+    std::unordered_map<uint32_t, uint32_t> slots;
+
+    uint32_t slot(const std::string& name) {
+        uint32_t nameId = program.intern(name);
+        auto it = slots.find(nameId);
+        if (it != slots.end())
+            return it->second;
+        std::vector<uint32_t>& slotNames = program.functions[current].slotNames;
+        uint32_t index = static_cast<uint32_t>(slotNames.size());
+        slotNames.push_back(nameId);
+        slots.emplace(nameId, index);
+        return index;
+    }
+
+    uint32_t addFunction(const std::string& name) {
+        program.functions.push_back({program.intern(name), 0, 0, {}});
+        return static_cast<uint32_t>(program.functions.size() - 1);
+    }
+
+    uint32_t emit(OpCode op, uint32_t a = 0, uint8_t flag = 0, uint32_t b = 0, uint32_t node = kNoNode) {
+        program.code.push_back({op, flag, a, b, node});
+        return static_cast<uint32_t>(program.code.size() - 1);
+    }
+
+    uint32_t here() const {
+        return static_cast<uint32_t>(program.code.size());
+    }
+
+    void trace(const Node& source, TraceAction action, const std::string& name = "", uint32_t branch = 0) {
+        emit(OpCode::Trace, program.intern(name), static_cast<uint8_t>(action), branch, source.id);
+    }
+
+    void expression(const Node& expr) {
+        if (expr.label == "Expr" && expr.children.size() == 1) {
+            std::string val = expr.children[0].label.substr(7); // "Value: "
+            if (!val.empty() && std::isdigit(static_cast<unsigned char>(val[0]))) {
+                int number = 0;
+                parseIntLiteral(val, number);
+                emit(OpCode::PushConst, static_cast<uint32_t>(number));
+            }
+            else if (isVariable(val)) {
+                emit(OpCode::Load, slot(val));
+            }
+            else {
+                // String and char literals, keywords, endl: no variable
+                // to read, and 0 as in the tree-walking simulator
+                emit(OpCode::PushConst, 0);
+            }
+            return;
+        }
+        if (expr.label == "Expr" && expr.children.size() == 3) {
+            bool known;
+            OpCode op = binaryOp(expr.children[1].label.substr(4), known); // "Op: "
+            if (known) {
+                expression(expr.children[0]);
+                expression(expr.children[2]);
+                emit(op);
+                return;
+            }
+        }
+        emit(OpCode::PushConst, 0);
+    }
+
+    void condition(const Node& node, size_t index, int fallback) {
+        if (node.children.size() > index)
+            expression(node.children[index]);
+        else
+            emit(OpCode::PushConst, static_cast<uint32_t>(fallback));
+    }
+
+    // Emits the capped loop skeleton shared by While and For.
+    template <typename Cond, typename Body>
+    void loop(Cond cond, Body body) {
+        emit(OpCode::LoopEnter);
+        uint32_t top = here();
+        cond();
+        uint32_t exitTest = emit(OpCode::JumpIfFalse);
+        uint32_t capTest = emit(OpCode::LoopCheck);
+        body();
+        emit(OpCode::LoopNext);
+        emit(OpCode::Jump, top);
+        program.code[exitTest].a = here();
+        program.code[capTest].a = here();
+        emit(OpCode::LoopExit);
+    }
+
+public:
+    explicit Compiler(BytecodeProgram& program) : program(program) {
+        for (size_t i = 0; i < program.functions.size(); ++i)
+            firstByName.emplace(program.names[program.functions[i].nameId], static_cast<uint32_t>(i));
+    }
+
+    void declare(const std::vector<Node>& functions) {
+        for (size_t i = 0; i < functions.size(); ++i) {
+            uint32_t index = addFunction(functionName(functions[i]));
+            program.functionIndex[&functions[i]] = index;
+            firstByName.emplace(functionName(functions[i]), index);
+        }
+    }
+
+    void function(const Node& func, uint32_t index) {
+        uint32_t outerFunction = current;
+        std::unordered_map<uint32_t, uint32_t> outerSlots;
+        outerSlots.swap(slots);
+        current = index;
+
+        program.functions[index].entry = here();
+        for (const auto& child : func.children) {
+            if (child.label != "Parameters")
+                continue;
+            for (const auto& param : child.children) {
+                size_t space = param.label.find(' ');
+                slot(space != std::string::npos ? param.label.substr(space + 1) : param.label);
+            }
+        }
+        program.functions[index].paramCount = program.functions[index].slotCount();
+
+        std::string name = functionName(func);
+        if (!name.empty()) {
+            trace(func, TraceAction::Call, name);
+            for (const auto& child : func.children) {
+                if (child.label == "Body") {
+                    for (const auto& stmt : child.children)
+                        statement(stmt);
+                }
+            }
+            trace(func, TraceAction::Return, name);
+        }
+        emit(OpCode::Ret);
+
+        current = outerFunction;
+        slots.swap(outerSlots);
+    }
+
+    void entry(const Node& node, uint32_t index) {
+        current = index;
+        slots.clear();
+        program.functions[index].entry = here();
+        statement(node);
+        emit(OpCode::Halt);
+    }
+
+    void statement(const Node& node) {
+        if (node.label == "Function") {
+            auto it = program.functionIndex.find(&node);
+            uint32_t index;
+            if (it != program.functionIndex.end()) {
+                index = it->second;
+            }
+            else {
+                // Not part of the program: compile it out of line
+                index = addFunction(functionName(node));
+                program.functionIndex[&node] = index;
+                uint32_t skip = emit(OpCode::Jump);
+                function(node, index);
+                program.code[skip].a = here();
+            }
+            emit(OpCode::Call, index, 0, 0);
+        }
+        else if (node.label == "VarDecl") {
+            std::string var;
+            if (!node.children.empty()) {
+                std::string decl = node.children[0].label;
+                size_t space = decl.find(' ');
+                var = (space != std::string::npos) ? decl.substr(space + 1) : decl;
+            }
+            condition(node, 1, 0);
+            emit(OpCode::Store, slot(var));
+            trace(node, TraceAction::VarDecl, var);
+        }
+        else if (node.label == "Assignment") {
+            std::string var;
+            if (!node.children.empty())
+                var = node.children[0].label.substr(5); // "Var: "
+            condition(node, 1, 0);
+            emit(OpCode::Store, slot(var));
+            trace(node, TraceAction::Assign, var);
+        }
+        else if (node.label == "Increment" || node.label == "Decrement") {
+            std::string var;
+            if (!node.children.empty())
+                var = node.children[0].label.substr(5); // "Var: "
+            uint32_t target = slot(var);
+            emit(OpCode::Load, target);
+            emit(OpCode::PushConst, 1);
+            emit(node.label == "Increment" ? OpCode::Add : OpCode::Sub);
+            emit(OpCode::Store, target);
+            trace(node, TraceAction::Assign, var);
+        }
+        else if (node.label == "Return") {
+            trace(node, TraceAction::ReturnStmt);
+            if (!node.children.empty()) {
+                expression(node.children[0]);
+                emit(OpCode::Pop);
+            }
+        }
+        else if (node.label == "If") {
+            trace(node, TraceAction::IfEnter);
+            condition(node, 0, 0);
+            uint32_t toElse = emit(OpCode::JumpIfFalse);
+            trace(node, TraceAction::IfTaken, "", 1);
+            if (node.children.size() > 1)
+                statement(node.children[1]);
+            uint32_t toEnd = emit(OpCode::Jump);
+            program.code[toElse].a = here();
+            trace(node, TraceAction::IfTaken, "", 0);
+            if (node.children.size() > 2)
+                statement(node.children[2]);
+            program.code[toEnd].a = here();
+        }
+        else if (node.label == "While") {
+            trace(node, TraceAction::WhileEnter);
+            loop([&] { condition(node, 0, 0); },
+                 [&] {
+                     if (node.children.size() > 1)
+                         statement(node.children[1]);
+                 });
+        }
+        else if (node.label == "For") {
+            trace(node, TraceAction::ForEnter);
+            if (!node.children.empty())
+                statement(node.children[0]);
+            loop([&] { condition(node, 1, 1); },
+                 [&] {
+                     if (node.children.size() > 3)
+                         statement(node.children[3]);
+                     if (node.children.size() > 2)
+                         statement(node.children[2]);
+                 });
+        }
+        else if (node.label == "Cout") {
+            trace(node, TraceAction::Cout);
+            for (const auto& child : node.children) {
+                expression(child);
+                emit(OpCode::Pop);
+            }
+        }
+        else if (node.label == "Cin") {
+            trace(node, TraceAction::Cin);
+            for (const auto& child : node.children) {
+                if (child.label.rfind("Var: ", 0) == 0)
+                    emit(OpCode::CinDefault, slot(child.label.substr(5)));
+            }
+        }
+        else if (node.label == "FunctionCall") {
+            std::string callee;
+            const Node* args = nullptr;
+            for (const auto& child : node.children) {
+                if (child.label.rfind("Callee:", 0) == 0 && callee.empty())
+                    callee = child.label.substr(7);
+                else if (child.label == "Arguments")
+                    args = &child;
+            }
+            if (!callee.empty()) {
+                trace(node, TraceAction::Call, callee);
+                auto it = firstByName.find(callee);
+                if (it != firstByName.end()) {
+                    // Arguments are evaluated in the caller's frame and bound
+                    // to the callee's parameter slots by position
+                    uint32_t argc = 0;
+                    if (args) {
+                        for (const auto& arg : args->children) {
+                            expression(arg);
+                            ++argc;
+                        }
+                    }
+                    emit(OpCode::Call, it->second, 0, argc);
+                }
+                trace(node, TraceAction::Return, callee);
+            }
+        }
+        else {
+            for (const auto& child : node.children)
+                statement(child);
+        }
+    }
+};
+
+} // namespace
+
+BytecodeProgram compileProgram(const std::vector<Node>& functions) {
+    BytecodeProgram program;
+    Compiler compiler(program);
+    compiler.declare(functions);
+    for (size_t i = 0; i < functions.size(); ++i)
+        compiler.function(functions[i], program.functionIndex[&functions[i]]);
+    return program;
+}
+
+uint32_t compileEntry(BytecodeProgram& program, const Node& node) {
+    program.functions.push_back({program.intern(""), 0, 0, {}});
+    uint32_t index = static_cast<uint32_t>(program.functions.size() - 1);
+    Compiler compiler(program);
+    compiler.entry(node, index);
+    return index;
+}
@@ -0,0 +1,301 @@
+#include "ColumnarTrace.h"
+#include <cstring>
+#include <fstream>
+#include "BufferedSink.h"
+#include "TraceGenerator.h"
+
+namespace {
+
+constexpr char kMagic[8] = {'T', 'R', 'C', 'O', 'L', 'S', '1', '\0'};
+constexpr size_t kHeaderSize = 8 + 4 + 8;
+constexpr size_t kNameSize = 12;
+constexpr size_t kEntrySize = kNameSize + 4 + 8 + 8;
+constexpr size_t kColumnCount = std::size(kTraceColumns);
+
+enum ColumnIndex { Step, Action, Function, Variable, Branch, Limit, Value, NodeId };
+
+void putFixed(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i)
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+uint64_t getFixed(const char* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    return value;
+}
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool getVarint(const char*& in, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; in != end && shift < 64; shift += 7) {
+        unsigned char byte = static_cast<unsigned char>(*in++);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+std::string encode(const std::vector<uint64_t>& values, ColumnEncoding encoding) {
+    std::string out;
+    switch (encoding) {
+    case ColumnEncoding::Plain:
+        for (uint64_t v : values)
+            putVarint(out, v);
+        break;
+    case ColumnEncoding::Delta: {
+        // Zigzag on the two's complement difference, shifted as unsigned
+        uint64_t previous = 0;
+        for (uint64_t v : values) {
+            uint64_t delta = v - previous;
+            putVarint(out, (delta << 1) ^ (0 - (delta >> 63)));
+            previous = v;
+        }
+        break;
+    }
+    case ColumnEncoding::RunLength:
+        for (size_t i = 0; i < values.size();) {
+            size_t run = 1;
+            while (i + run < values.size() && values[i + run] == values[i])
+                ++run;
+            putVarint(out, values[i]);
+            putVarint(out, run);
+            i += run;
+        }
+        break;
+    }
+    return out;
+}
+
+bool decode(const std::string& bytes, ColumnEncoding encoding, uint64_t count, std::vector<uint64_t>& out) {
+    out.clear();
+    out.reserve(count);
+    const char* in = bytes.data();
+    const char* end = in + bytes.size();
+    uint64_t value, run;
+    uint64_t previous = 0;
+    while (out.size() < count) {
+        if (!getVarint(in, end, value))
+            return false;
+        switch (encoding) {
+        case ColumnEncoding::Plain:
+            out.push_back(value);
+            break;
+        case ColumnEncoding::Delta:
+            previous += (value >> 1) ^ (0 - (value & 1));
+            out.push_back(previous);
+            break;
+        case ColumnEncoding::RunLength:
+            if (!getVarint(in, end, run) || run > count - out.size())
+                return false;
+            out.insert(out.end(), run, value);
+            break;
+        }
+    }
+    return in == end;
+}
+
+} // namespace
+
+void ColumnarTraceBuilder::add(const TraceEvent& event) {
+    uint32_t name = event.name == kNoName ? 0 : event.name + 1;
+    columns[Step].push_back(event.step);
+    columns[Action].push_back(static_cast<uint64_t>(event.action));
+    columns[Function].push_back(
+        event.action == TraceAction::Call || event.action == TraceAction::Return ? name : 0);
+    columns[Variable].push_back(
+        event.action == TraceAction::VarDecl || event.action == TraceAction::Assign ? name : 0);
+    columns[Branch].push_back(event.action == TraceAction::IfTaken ? event.branch + 1u : 0);
+    columns[Limit].push_back(event.action == TraceAction::BudgetExhausted ? name : 0);
+    uint32_t value = static_cast<uint32_t>(event.value);
+    columns[Value].push_back(traceEventHasValue(event.action) ? (value << 1) ^ (0u - (value >> 31)) : 0);
+    columns[NodeId].push_back(event.node == kNoNode ? 0 : event.node + 1);
+}
+
+bool ColumnarTraceBuilder::write(const std::string& path, const StringPool& names, bool values, bool atomic) const {
+    std::string strings;
+    putFixed(strings, names.strings.size(), 4);
+    for (const auto& s : names.strings) {
+        putVarint(strings, s.size());
+        strings += s;
+    }
+
+    std::string blocks[kColumnCount];
+    ColumnEncoding encodings[kColumnCount];
+    for (size_t c = 0; c < kColumnCount; ++c) {
+        for (ColumnEncoding encoding : {ColumnEncoding::Plain, ColumnEncoding::Delta, ColumnEncoding::RunLength}) {
+            std::string block = encode(columns[c], encoding);
+            if (encoding == ColumnEncoding::Plain || block.size() < blocks[c].size()) {
+                blocks[c] = std::move(block);
+                encodings[c] = encoding;
+            }
+        }
+    }
+
+    size_t written = values ? kColumnCount : kColumnCount - 1;
+    std::string header(kMagic, sizeof(kMagic));
+    putFixed(header, written, 4);
+    putFixed(header, columns[Step].size(), 8);
+    uint64_t offset = kHeaderSize + written * kEntrySize + strings.size();
+    for (size_t c = 0; c < kColumnCount; ++c) {
+        if (c == Value && !values)
+            continue;
+        char name[kNameSize] = {};
+        std::strncpy(name, kTraceColumns[c], kNameSize - 1);
+        header.append(name, kNameSize);
+        putFixed(header, static_cast<uint64_t>(encodings[c]), 4);
+        putFixed(header, offset, 8);
+        putFixed(header, blocks[c].size(), 8);
+        offset += blocks[c].size();
+    }
+
+    BufferedSink sink(path, atomic);
+    sink.write(header);
+    sink.write(strings);
+    for (size_t c = 0; c < kColumnCount; ++c) {
+        if (c != Value || values)
+            sink.write(blocks[c]);
+    }
+    sink.close();
+    return sink.ok();
+}
+
+std::vector<std::string> ColumnarTrace::columnNames() const {
+    std::vector<std::string> names;
+    for (const auto& column : directory)
+        names.push_back(column.name);
+    return names;
+}
+
+bool ColumnarTrace::hasColumn(const std::string& name) const {
+    for (const auto& column : directory) {
+        if (column.name == name)
+            return true;
+    }
+    return false;
+}
+
+Result<std::vector<uint64_t>> ColumnarTrace::column(const std::string& name) const {
+    Result<std::vector<uint64_t>> result;
+    for (const auto& column : directory) {
+        if (column.name != name)
+            continue;
+        std::ifstream in(path, std::ios::binary);
+        std::string bytes(column.size, '\0');
+        in.seekg(static_cast<std::streamoff>(column.offset));
+        if (!in.read(&bytes[0], static_cast<std::streamsize>(bytes.size())) ||
+            !decode(bytes, column.encoding, events, result.value))
+            result.diagnostics.push_back({"Corrupt column " + name + " in " + path});
+        return result;
+    }
+    result.diagnostics.push_back({"No column " + name + " in " + path});
+    return result;
+}
+
+Result<ColumnarTrace> openColumnarTrace(const std::string& path) {
+    Result<ColumnarTrace> result;
+    ColumnarTrace& trace = result.value;
+    trace.path = path;
+    auto fail = [&](const std::string& message) {
+        result.diagnostics.push_back({message + ": " + path});
+        return result;
+    };
+
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    uint64_t fileSize = in ? static_cast<uint64_t>(in.tellg()) : 0;
+    in.seekg(0);
+    char header[kHeaderSize];
+    if (!in.read(header, kHeaderSize) || std::memcmp(header, kMagic, sizeof(kMagic)) != 0)
+        return fail("Not a columnar trace");
+    uint64_t columns = getFixed(header + 8, 4);
+    trace.events = getFixed(header + 12, 8);
+
+    // Check every size against the file before allocating for it
+    uint64_t directoryEnd = kHeaderSize + columns * kEntrySize;
+    if (columns > fileSize / kEntrySize || directoryEnd > fileSize)
+        return fail("Truncated column directory");
+    std::string entries(columns * kEntrySize, '\0');
+    if (!in.read(&entries[0], static_cast<std::streamsize>(entries.size())))
+        return fail("Truncated column directory");
+    for (uint64_t c = 0; c < columns; ++c) {
+        const char* entry = entries.data() + c * kEntrySize;
+        auto encoding = static_cast<uint8_t>(entry[kNameSize]);
+        uint64_t offset = getFixed(entry + kNameSize + 4, 8);
+        uint64_t size = getFixed(entry + kNameSize + 12, 8);
+        if (encoding > static_cast<uint8_t>(ColumnEncoding::RunLength) || offset < directoryEnd ||
+            offset > fileSize || size > fileSize - offset)
+            return fail("Corrupt column directory");
+        trace.directory.push_back({std::string(entry, strnlen(entry, kNameSize)),
+                                   static_cast<ColumnEncoding>(encoding), offset, size});
+        // Consecutive events never share a step, so every event takes at
+        // least a byte of the step column whichever encoding it got
+        if (trace.directory.back().name == kTraceColumns[Step] && trace.events > size)
+            return fail("Corrupt event count");
+    }
+
+    // The string table runs up to the first column block
+    uint64_t tableEnd = trace.directory.empty() ? fileSize : trace.directory.front().offset;
+    std::string table(tableEnd - directoryEnd, '\0');
+    if (!in.read(&table[0], static_cast<std::streamsize>(table.size())) || table.size() < 4)
+        return fail("Truncated string table");
+    const char* at = table.data() + 4;
+    const char* end = table.data() + table.size();
+    for (uint64_t i = 0, count = getFixed(table.data(), 4); i < count; ++i) {
+        uint64_t length;
+        if (!getVarint(at, end, length) || length > static_cast<uint64_t>(end - at))
+            return fail("Corrupt string table");
+        trace.table.emplace_back(at, length);
+        at += length;
+    }
+    return result;
+}
+
+Result<json> columnarTraceToJson(const ColumnarTrace& trace) {
+    Result<json> result;
+    bool values = trace.hasColumn(kTraceColumns[Value]);
+    std::vector<uint64_t> columns[kColumnCount];
+    for (size_t c = 0; c < kColumnCount; ++c) {
+        if (c == Value && !values) {
+            columns[c].assign(trace.size(), 0);
+            continue;
+        }
+        auto column = trace.column(kTraceColumns[c]);
+        if (!column.ok()) {
+            result.diagnostics = std::move(column.diagnostics);
+            return result;
+        }
+        columns[c] = std::move(column.value);
+    }
+
+    StringPool names;
+    for (const auto& s : trace.strings())
+        names.intern(s);
+    result.value = json::array();
+    for (uint64_t i = 0; i < trace.size(); ++i) {
+        uint64_t name = columns[Function][i] | columns[Variable][i] | columns[Limit][i];
+        auto action = static_cast<TraceAction>(columns[Action][i]);
+        if (columns[Action][i] >= kTraceActionCount || columns[Branch][i] > 2 || name > names.strings.size() ||
+            traceEventHasName(action) != (name != 0) || columns[Value][i] > UINT32_MAX ||
+            columns[NodeId][i] > UINT32_MAX) {
+            result.diagnostics.push_back({"Corrupt event " + std::to_string(i) + " in columnar trace"});
+            return result;
+        }
+        uint8_t branch = columns[Branch][i] ? static_cast<uint8_t>(columns[Branch][i] - 1) : 0;
+        auto zigzag = static_cast<uint32_t>(columns[Value][i]);
+        int value = static_cast<int>((zigzag >> 1) ^ (0u - (zigzag & 1)));
+        auto node = static_cast<uint32_t>(columns[NodeId][i]);
+        TraceEvent event{action, branch, 0, name ? static_cast<uint32_t>(name - 1) : kNoName,
+                         node ? node - 1 : kNoNode, value, columns[Step][i]};
+        result.value.push_back(traceEventToJson(event, names, values));
+    }
+    return result;
+}
@@ -0,0 +1,89 @@
+#include "HashCons.h"
+#include <cstdio>
+#include "BufferedSink.h"
+
+namespace {
+
+constexpr uint64_t kFnvOffset = 1469598103934665603ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+uint64_t fnv1a(uint64_t h, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        h ^= bytes[i];
+        h *= kFnvPrime;
+    }
+    return h;
+}
+
+uint64_t mixWord(uint64_t h, uint64_t word) {
+    for (int i = 0; i < 8; ++i) {
+        h ^= (word >> (i * 8)) & 0xff;
+        h *= kFnvPrime;
+    }
+    return h;
+}
+
+uint64_t combine(const std::string& label, const std::vector<uint64_t>& childHashes) {
+    uint64_t h = fnv1a(kFnvOffset, label.data(), label.size());
+    h = mixWord(h, childHashes.size());
+    for (uint64_t child : childHashes)
+        h = mixWord(h, child);
+    return h;
+}
+
+std::string hexHash(uint64_t hash) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(hash));
+    return buf;
+}
+
+} // namespace
+
+const SharedNode* NodeInterner::intern(Node&& node) {
+    ++requests;
+    std::vector<const SharedNode*> children;
+    std::vector<uint64_t> childHashes;
+    children.reserve(node.children.size());
+    childHashes.reserve(node.children.size());
+    for (auto& child : node.children) {
+        children.push_back(intern(std::move(child)));
+        childHashes.push_back(children.back()->hash);
+    }
+    std::vector<Node>().swap(node.children);
+    uint64_t hash = combine(node.label, childHashes);
+
+    // Children are already interned, so comparing their pointers is enough
+    auto& bucket = buckets[hash];
+    for (const SharedNode* candidate : bucket) {
+        if (candidate->label == node.label && candidate->children == children)
+            return candidate;
+    }
+    nodes.push_back({std::move(node.label), std::move(children), hash, nodes.size()});
+    bucket.push_back(&nodes.back());
+    return &nodes.back();
+}
+
+bool writeSharedJson(const SharedNode* root, const NodeInterner& interner, const std::string& path) {
+    BufferedSink sink(path);
+    const auto& nodes = interner.uniqueNodes();
+    sink.write("{\n    \"nodes\": [");
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const SharedNode& node = nodes[i];
+        sink.write(i ? ",\n        {\n            \"children\": [" : "\n        {\n            \"children\": [");
+        for (size_t c = 0; c < node.children.size(); ++c) {
+            sink.write(c ? ",\n                " : "\n                ");
+            sink.write(std::to_string(node.children[c]->index));
+        }
+        sink.write(node.children.empty() ? "],\n            \"hash\": \"" : "\n            ],\n            \"hash\": \"");
+        sink.write(hexHash(node.hash));
+        sink.write("\",\n            \"name\": ");
+        sink.writeJsonString(node.label);
+        sink.write("\n        }");
+    }
+    sink.write(nodes.empty() ? "],\n    \"root\": " : "\n    ],\n    \"root\": ");
+    sink.write(std::to_string(root ? root->index : 0));
+    sink.write("\n}");
+    sink.close();
+    return sink.ok();
+}
@@ -1,11 +1,29 @@
 #include "Node.h"
 
-json nodeToJson(const Node& node) {
+namespace {
+
+void assignNodeIds(Node& node, uint32_t& next) {
+    node.id = next++;
+    for (auto& child : node.children)
+        assignNodeIds(child, next);
+}
+
+} // namespace
+
+void assignNodeIds(Node& root) {
+    uint32_t next = 0;
+    assignNodeIds(root, next);
+}
+
+json nodeToJson(const Node& node, bool includeSpans) {
     json j;
+    j["id"] = node.id;
     j["name"] = node.label;
+    if (includeSpans)
+        j["span"] = {node.offset, node.length};
     j["children"] = json::array();
     for (const auto& child : node.children) {
-        j["children"].push_back(nodeToJson(child));
+        j["children"].push_back(nodeToJson(child, includeSpans));
     }
     return j;
 } 
\ No newline at end of file
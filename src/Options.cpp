@@ -0,0 +1,162 @@
+#include "Options.h"
+#include <charconv>
+#include <string>
+
+namespace {
+
+template <typename T>
+bool parseNumber(const std::string& text, T& value) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+} // namespace
+
+Result<Options> parseOptions(int argc, char* argv[]) {
+    Result<Options> result;
+    Options& options = result.value;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        // Flags that take a numeric value
+        auto number = [&](auto& field) {
+            if (i + 1 >= argc || !parseNumber(argv[i + 1], field))
+                result.diagnostics.push_back({"Expected a number after " + arg});
+            ++i;
+        };
+
+        if (arg == "--max-steps")
+            number(options.budget.maxSteps);
+        else if (arg == "--max-depth")
+            number(options.budget.maxCallDepth);
+        else if (arg == "--max-events")
+            number(options.budget.maxTraceEvents);
+        else if (arg == "--timeout-ms")
+            number(options.budget.timeLimitMs);
+        else if (arg == "--max-loop-iterations")
+            number(options.budget.maxLoopIterations);
+        else if (arg == "--trace-chunk-events")
+            number(options.traceOutput.chunkEvents);
+        else if (arg == "--state-keyframes")
+            number(options.stateKeyframes);
+        else if (arg == "--trace-sample")
+            number(options.tracePolicy.sampleEvery);
+        else if (arg == "--trace-last")
+            number(options.tracePolicy.keepLast);
+        else if (arg == "--trace-level") {
+            std::string level = i + 1 < argc ? argv[++i] : "";
+            if (level == "function")
+                options.tracePolicy.granularity = TraceGranularity::Function;
+            else if (level == "statement")
+                options.tracePolicy.granularity = TraceGranularity::Statement;
+            else
+                result.diagnostics.push_back({"Unknown trace level: " + level});
+        }
+        else if (arg == "--fold-period")
+            number(options.traceOutput.foldPeriod);
+        else if (arg == "--trace-values")
+            options.traceOutput.values = true;
+        else if (arg == "--trace-index")
+            options.traceOutput.index = true;
+        else if (arg == "--fold-trace")
+            options.traceOutput.fold = true;
+        else if (arg == "--stream-trace")
+            options.streamTrace = true;
+        else if (arg == "--trace-format") {
+            std::string format = i + 1 < argc ? argv[++i] : "";
+            if (format == "json")
+                options.traceOutput.format = TraceFormat::Json;
+            else if (format == "ndjson")
+                options.traceOutput.format = TraceFormat::NdJson;
+            else if (format == "columnar")
+                options.traceOutput.format = TraceFormat::Columnar;
+            else
+                result.diagnostics.push_back({"Unknown trace format: " + format});
+        }
+        else if (arg == "--diff-trace") {
+            if (i + 2 >= argc)
+                result.diagnostics.push_back({"Expected two trace files after --diff-trace"});
+            else {
+                options.diffFirst = argv[++i];
+                options.diffSecond = argv[++i];
+            }
+        }
+        else if (arg == "--atomic-writes") {
+            // The trace writer stages its own files (chunks, manifest, index)
+            options.atomicWrites = true;
+            options.traceOutput.atomic = true;
+        }
+        else if (arg == "--no-io-uring")
+            options.ioUring = false;
+        else if (arg == "--bundle")
+            options.bundle = true;
+        else if (arg == "--unbundle") {
+            if (i + 1 >= argc)
+                result.diagnostics.push_back({"Expected a bundle file after --unbundle"});
+            else
+                options.unbundlePath = argv[++i];
+        }
+        else if (arg == "--hash-cons")
+            options.hashCons = true;
+        else if (arg == "--tree-threads")
+            number(options.treeThreads);
+        else if (arg == "--tree-format") {
+            std::string format = i + 1 < argc ? argv[++i] : "";
+            if (format == "pretty")
+                options.compactTree = false;
+            else if (format == "compact")
+                options.compactTree = true;
+            else
+                result.diagnostics.push_back({"Unknown tree format: " + format});
+        }
+        else if (arg == "--tree-schema") {
+            std::string schema = i + 1 < argc ? argv[++i] : "";
+            if (schema == "nested")
+                options.treeSchema = TreeSchema::Nested;
+            else if (schema == "dictionary")
+                options.treeSchema = TreeSchema::Dictionary;
+            else
+                result.diagnostics.push_back({"Unknown tree schema: " + schema});
+        }
+        else if (arg == "--tree-depth")
+            number(options.treeDetailDepth);
+        else if (arg == "--tree-nodes")
+            number(options.treeDetailNodes);
+        else if (arg == "--tree-layout")
+            options.treeLayout = true;
+        else if (arg == "--spans")
+            options.spans = true;
+        else
+            result.diagnostics.push_back({"Unknown option: " + arg});
+    }
+    // Folding needs the whole trace in memory and writes a single JSON document
+    const TraceWriterOptions& out = options.traceOutput;
+    if (out.fold && (options.streamTrace || out.chunkEvents || out.format != TraceFormat::Json))
+        result.diagnostics.push_back({"--fold-trace cannot be combined with streaming, chunked or NDJSON output"});
+    if (options.tracePolicy.keepLast && options.streamTrace)
+        result.diagnostics.push_back({"--trace-last cannot be combined with --stream-trace"});
+    // A file needs room for its root, one child and a continuation stub
+    if (options.treeDetailNodes && options.treeDetailNodes < 3)
+        result.diagnostics.push_back({"--tree-nodes must be at least 3 (or 0 for no limit)"});
+    if ((options.treeDetailDepth || options.treeDetailNodes) && options.treeSchema != TreeSchema::Nested)
+        result.diagnostics.push_back({"--tree-depth and --tree-nodes write the nested tree schema only"});
+    if (options.bundle && options.streamTrace)
+        result.diagnostics.push_back({"--bundle needs the trace in memory and cannot be combined with --stream-trace"});
+    // --unbundle rebuilds tree.json and trace.json from the header flags,
+    // which only describe the default trace output and a single tree file
+    if (options.bundle && (out.fold || out.chunkEvents || out.format != TraceFormat::Json))
+        result.diagnostics.push_back({"--bundle cannot be combined with --fold-trace, --trace-chunk-events or a non-JSON --trace-format"});
+    if (options.bundle && (options.treeDetailDepth || options.treeDetailNodes))
+        result.diagnostics.push_back({"--bundle cannot be combined with --tree-depth or --tree-nodes"});
+    if (options.tracePolicy.sampleEvery == 0)
+        result.diagnostics.push_back({"--trace-sample must be at least 1"});
+    if (out.format == TraceFormat::Columnar && (out.chunkEvents || out.index))
+        result.diagnostics.push_back({"Columnar traces are written as one file and cannot be chunked or indexed"});
+    if (out.format == TraceFormat::Columnar && options.streamTrace)
+        result.diagnostics.push_back({"Columnar traces are encoded as a whole and cannot be combined with --stream-trace"});
+    if (out.fold && out.index)
+        result.diagnostics.push_back({"--trace-index cannot index a folded trace"});
+    if (out.foldPeriod == 0)
+        result.diagnostics.push_back({"--fold-period must be at least 1"});
+    return result;
+}
@@ -1,355 +1,328 @@
 #include "Parser.h"
-#include "SymbolTable.h"
-#include <stdexcept>
 
 std::vector<Node> allFunctions;
 
-Parser::Parser(const std::vector<Token>& tokens) : tokens(tokens) {}
+// A grammar symbol still to be parsed or, with no symbol, the reduction of
+// `production` once its symbols are. Both carry the alternative's first
+// value and token.
+struct Parser::Frame {
+    const GrammarSymbol* symbol;
+    const Production* production;
+    size_t base;
+    size_t start;
+};
 
-Token Parser::peek() {
-    if (pos < tokens.size())
-        return tokens[pos];
-    throw std::runtime_error("Unexpected end of input");
+Parser::Parser(const std::vector<Token>& tokens, const LanguageSpec& spec)
+    : tokens(tokens), spec(spec), grammar(*spec.grammar) {
+    if (!tokens.empty()) {
+        endOfInput.line = tokens.back().line;
+        endOfInput.column = tokens.back().column + static_cast<int>(tokens.back().value.size());
+        endOfInput.offset = tokens.back().offset + static_cast<uint32_t>(tokens.back().value.size());
+    }
+    terminals.reserve(tokens.size() + 1);
+    for (const Token& token : tokens)
+        terminals.push_back(classify(token));
+    terminals.push_back(T_Eof);
 }
 
-Token Parser::advance() {
-    if (pos < tokens.size())
-        return tokens[pos++];
-    throw std::runtime_error("Unexpected end of input");
+const Token& Parser::current() const {
+    return pos < tokens.size() ? tokens[pos] : endOfInput;
 }
 
-bool Parser::match(const std::string& val) {
-    if (pos < tokens.size() && tokens[pos].value == val) {
-        ++pos;
-        return true;
-    }
-    return false;
+uint8_t Parser::classify(const Token& token) const {
+    uint8_t literal = grammar.literal(token.value);
+    if (literal != T_Other)
+        return literal;
+    if (token.type == "preprocessor")
+        return T_Preprocessor;
+    if (spec.typeNames.contains(token.value))
+        return T_Type;
+    if (token.type == "identifier")
+        return T_Ident;
+    if (token.type == "symbol" && spec.binaryOperators.contains(token.value))
+        return T_BinOp;
+    return T_Other;
 }
 
-bool Parser::matchType(const std::string& type) {
-    if (pos < tokens.size() && tokens[pos].type == type) {
-        ++pos;
-        return true;
+// Records a diagnostic at `at` and enters panic mode; further errors are
+// suppressed until a recovery list resynchronizes.
+Node Parser::fail(const Token& at, const std::string& message) {
+    if (!panicking) {
+        diagnostics.push_back({message, at.line, at.column});
+        panicking = true;
     }
-    return false;
+    return ActionContext::leaf("Error: " + message, at);
 }
 
-Node Parser::parse() {
-    Node root = {"Program"};
-    while (pos < tokens.size() && tokens[pos].type == "preprocessor") {
-        root.children.push_back({"Include: " + tokens[pos].value});
-        ++pos;
-    }
-    while (pos + 2 < tokens.size() &&
-           tokens[pos].value == "using" &&
-           tokens[pos + 1].value == "namespace" &&
-           tokens[pos + 2].type == "identifier") {
-        std::string ns = tokens[pos + 2].value;
-        root.children.push_back({"Using: namespace " + ns});
-        pos += 3;
-        if (pos < tokens.size() && tokens[pos].value == ";")
-            ++pos;
-    }
-    while (pos < tokens.size()) {
-        Node func = parseFunction();
-        root.children.push_back(func);
-        allFunctions.push_back(func);
-    }
-    return root;
+ActionContext Parser::context(size_t start) {
+    return {start < tokens.size() ? tokens[start] : endOfInput, pos > start ? &tokens[pos - 1] : nullptr,
+            currentScope};
 }
 
-Node Parser::parseFunction() {
-    Node funcNode = {"Function"};
-    std::string returnType;
-    if (match("int")) returnType = "int";
-    else if (match("void")) returnType = "void";
-    else if (match("float")) returnType = "float";
-    else if (match("double")) returnType = "double";
-    else if (match("char")) returnType = "char";
-    else if (match("bool")) returnType = "bool";
-    else if (match("string")) returnType = "string";
-    else throw std::runtime_error("Expected return type");
-
-    Token name = advance();
-    if (name.type != "identifier")
-        throw std::runtime_error("Expected function name");
+Node ActionContext::finish(Node node) const {
+    node.offset = first.offset;
+    if (last)
+        node.length = last->offset + static_cast<uint32_t>(last->value.size()) - first.offset;
+    return node;
+}
 
-    funcNode.children.push_back({"ReturnType: " + returnType});
-    funcNode.children.push_back({"FunctionName: " + name.value});
+Node ActionContext::leaf(std::string label, const Token& token) {
+    Node node = {std::move(label)};
+    node.offset = token.offset;
+    node.length = static_cast<uint32_t>(token.value.size());
+    return node;
+}
 
-    std::string prevScope = currentScope;
-    currentScope = name.value;
+Node ActionContext::span(Node node, const Token& from, const Token& to) {
+    node.offset = from.offset;
+    node.length = to.offset + static_cast<uint32_t>(to.value.size()) - from.offset;
+    return node;
+}
 
-    if (!match("("))
-        throw std::runtime_error("Expected (");
-    Node paramList = {"Parameters"};
-    if (!match(")")) {
-        do {
-            std::string paramType;
-            if (match("int")) paramType = "int";
-            else if (match("void")) paramType = "void";
-            else if (match("float")) paramType = "float";
-            else if (match("double")) paramType = "double";
-            else if (match("char")) paramType = "char";
-            else if (match("bool")) paramType = "bool";
-            else if (match("string")) paramType = "string";
-            else throw std::runtime_error("Expected parameter type");
-            Token paramName = advance();
-            if (paramName.type != "identifier")
-                throw std::runtime_error("Expected parameter name");
-            paramList.children.push_back({paramType + " " + paramName.value});
-        } while (match(","));
-        if (!match(")"))
-            throw std::runtime_error("Expected )");
+// Statement-level recovery: skip to just past the next ';' at brace depth 0,
+// or stop before an unmatched '}', a token that starts a statement (one of
+// `stops`), or a function header. Parenthesised groups are skipped whole, so
+// "int fact(int n)" does not resume at the parameter's type, but a ';' or
+// an unmatched '}' always ends the skip, so an unclosed '(' cannot hide the
+// statements after it. A '{' reached on the way opens the bad statement's
+// body (a nested function definition, say), which is skipped to its
+// closing brace unless another function starts first.
+void Parser::synchronize(size_t start, uint64_t stops) {
+    panicking = false;
+    if (pos == start && pos < tokens.size())
+        ++pos;
+    int parens = 0;
+    int braces = 0;
+    while (pos < tokens.size()) {
+        const std::string& val = tokens[pos].value;
+        if (atFunctionHeader())
+            return;
+        if (val == "(") {
+            ++parens;
+        }
+        else if (val == ")") {
+            if (parens > 0)
+                --parens;
+        }
+        else if (val == "{") {
+            ++braces;
+        }
+        else if (val == "}") {
+            if (braces == 0)
+                return;
+            ++pos;
+            if (--braces == 0 && parens == 0)
+                return;
+            continue;
+        }
+        else if (val == ";" && braces == 0) {
+            ++pos;
+            return;
+        }
+        else if (parens == 0 && braces == 0 && (stops >> terminals[pos] & 1)) {
+            return;
+        }
+        ++pos;
     }
-    funcNode.children.push_back(paramList);
-
-    if (!match("{"))
-        throw std::runtime_error("Expected {");
+}
 
-    Node body = {"Body"};
-    while (!match("}")) {
-        body.children.push_back(parseStatement());
+// Function-level recovery: skip past the current brace-balanced region and
+// stop at the next token that starts a function (a type name) at top level.
+void Parser::synchronizeFunction(size_t start, uint64_t stops) {
+    panicking = false;
+    currentScope = "global";
+    if (pos == start && pos < tokens.size())
+        ++pos;
+    int depth = 0;
+    while (pos < tokens.size()) {
+        const std::string& val = tokens[pos].value;
+        if (depth == 0 && (stops >> terminals[pos] & 1))
+            return;
+        ++pos;
+        if (val == "{")
+            ++depth;
+        else if (val == "}" && depth > 0 && --depth == 0)
+            return;
     }
-    funcNode.children.push_back(body);
-
-    currentScope = prevScope;
-    return funcNode;
 }
 
-Node Parser::parseStatement() {
-    std::string varType;
-    if (match("int")) varType = "int";
-    else if (match("void")) varType = "void";
-    else if (match("float")) varType = "float";
-    else if (match("double")) varType = "double";
-    else if (match("char")) varType = "char";
-    else if (match("bool")) varType = "bool";
-    else if (match("string")) varType = "string";
+// A type name, an identifier and '(' at the start of a line start a
+// function definition, which is never part of a statement: inside a body it
+// means the body was not closed. An indented header is a nested definition
+// and is skipped as one bad statement instead.
+bool Parser::atFunctionHeader() const {
+    return pos + 2 < tokens.size() && tokens[pos].column == 1 && terminals[pos] == T_Type &&
+           tokens[pos + 1].type == "identifier" && tokens[pos + 2].value == "(";
+}
 
-    if (!varType.empty()) {
-        Token varName = advance();
-        if (varName.type != "identifier")
-            throw std::runtime_error("Expected variable name");
-        Node decl = {"VarDecl"};
-        decl.children.push_back({varType + " " + varName.value});
-        
-        // Add to symbol table
-        SymbolEntry entry;
-        entry.name = varName.value;
-        entry.type = varType;
-        entry.scope = currentScope;
-        entry.hasValue = false;
-        symbolTable.push_back(entry);
-        
-        if (match("=")) {
-            Node expr = parseExpression();
-            decl.children.push_back(expr);
-            // If initializing with a constant, store its value
-            if (expr.children[0].label.substr(0, 7) == "Value: ") {
-                try {
-                    entry.value = std::stoi(expr.children[0].label.substr(7));
-                    entry.hasValue = true;
-                    symbolTable.back() = entry;  // Update the entry we just added
-                } catch (...) {}
-            }
-        }
-        if (!match(";"))
-            throw std::runtime_error("Expected ; after variable declaration");
-        return decl;
-    }
+// First token of the innermost recovery-list element being parsed, which
+// is `expanding` itself if that is an element
+size_t Parser::elementStart(const std::vector<Frame>& stack, int expanding) const {
+    if (expanding >= 0 && grammar.element[expanding])
+        return pos;
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it)
+        if (!it->symbol && grammar.element[it->production->lhs])
+            return it->start;
+    return pos;
+}
 
-    if (match("return")) {
-        Node retNode = {"Return"};
-        retNode.children.push_back(parseExpression());
-        if (!match(";"))
-            throw std::runtime_error("Expected ; after return");
-        return retNode;
+// A grammar message with `$` replaced by the element's first token, where
+// it is then reported; other messages are reported at the current token
+std::string Parser::describe(std::string_view message, const std::vector<Frame>& stack, int expanding,
+                             const Token*& at) const {
+    at = &current();
+    size_t dollar = message.find('$');
+    if (dollar == std::string_view::npos)
+        return std::string(message);
+    size_t start = elementStart(stack, expanding);
+    if (start >= tokens.size()) {
+        at = &endOfInput;
+        return "Unexpected end of input";
     }
+    at = &tokens[start];
+    return std::string(message.substr(0, dollar)) + at->value + std::string(message.substr(dollar + 1));
+}
 
-    if (match("if")) {
-        Node ifNode = {"If"};
-        if (!match("("))
-            throw std::runtime_error("Expected ( after if");
-        ifNode.children.push_back(parseExpression());
-        if (!match(")"))
-            throw std::runtime_error("Expected ) after if condition");
-        ifNode.children.push_back(parseStatement());
-        if (match("else"))
-            ifNode.children.push_back(parseStatement());
-        return ifNode;
+// The diagnostic for a terminal that is not there. A missing identifier
+// takes the place of the token there, which is skipped.
+std::string Parser::missing(const GrammarSymbol& symbol, const std::vector<Frame>& stack, const Token*& at) {
+    if (pos >= tokens.size() && (symbol.id == kAnyToken || symbol.id == T_Ident)) {
+        at = &endOfInput;
+        return "Unexpected end of input";
     }
+    std::string message;
+    at = &current();
+    if (!symbol.message.empty())
+        message = describe(symbol.message, stack, -1, at);
+    else if (symbol.id == T_Ident)
+        message = "Expected identifier";
+    else if (symbol.id == T_Type)
+        message = "Expected type name";
+    else if (symbol.id == T_BinOp)
+        message = "Expected operator";
+    else if (symbol.id == T_Preprocessor)
+        message = "Expected preprocessor line";
+    else
+        message = "Expected " + std::string(grammar.literals[symbol.id]);
+    if (symbol.id == T_Ident)
+        ++pos;
+    return message;
+}
 
-    if (match("while")) {
-        Node whileNode = {"While"};
-        if (!match("("))
-            throw std::runtime_error("Expected ( after while");
-        whileNode.children.push_back(parseExpression());
-        if (!match(")"))
-            throw std::runtime_error("Expected ) after while condition");
-        whileNode.children.push_back(parseStatement());
-        return whileNode;
+// Picks the alternative of the frame's nonterminal for the current token
+// and pushes it. A statement list ends at a function header or the end of
+// input; a recovery list that follows a failed element (as the `List` of
+// `Element List`) first resynchronizes.
+void Parser::expand(const Frame& frame, std::vector<Frame>& stack, std::vector<ParseValue>& values) {
+    uint8_t nonterminal = frame.symbol->id;
+    Recovery recovery = grammar.recovery[nonterminal];
+    if (recovery != Recovery::None) {
+        if (panicking && frame.production && frame.production->lhs == nonterminal) {
+            if (recovery == Recovery::Function)
+                synchronizeFunction(frame.start, grammar.stops[nonterminal]);
+            else if (!atFunctionHeader())
+                synchronize(frame.start, grammar.stops[nonterminal]);
+        }
+        // Leave the next function to the function list, which resumes there
+        if (recovery == Recovery::Statement && (pos >= tokens.size() || atFunctionHeader())) {
+            ParseValue end;
+            end.list.push_back(pos >= tokens.size()
+                                   ? fail(endOfInput, "Unexpected end of input")
+                                   : fail(tokens[pos], "Expected } before function " + tokens[pos + 1].value));
+            values.push_back(std::move(end));
+            return;
+        }
     }
 
-    if (match("for")) {
-        Node forNode = {"For"};
-        if (!match("("))
-            throw std::runtime_error("Expected ( after for");
-        if (tokens[pos].value != ";")
-            forNode.children.push_back(parseStatement());
-        else
+    uint8_t entry = grammar.table[nonterminal][terminals[pos]];
+    if (entry == kErrorEntry) {
+        const Token* at = nullptr;
+        std::string message = describe(grammar.errors[nonterminal], stack, nonterminal, at);
+        // A rejected token the error is reported at goes with the failed
+        // element, so recovery resumes after it
+        if (at == &current() && pos < tokens.size())
             ++pos;
-        if (tokens[pos].value != ";")
-            forNode.children.push_back(parseExpression());
-        else
-            forNode.children.push_back({"Expr", {{"Value: 1"}}});
-        if (!match(";"))
-            throw std::runtime_error("Expected ; after for condition");
-        if (tokens[pos].value != ")") {
-            size_t savePos = pos;
-            Token lookahead = tokens[pos];
-            if (lookahead.type == "identifier" && pos + 1 < tokens.size() && tokens[pos + 1].value == "=") {
-                Token var = advance();
-                match("=");
-                Node assign = {"Assignment"};
-                assign.children.push_back({"Var: " + var.value});
-                assign.children.push_back(parseExpression());
-                forNode.children.push_back(assign);
-            }
-            else {
-                forNode.children.push_back(parseExpression());
-            }
-        }
-        else {
-            forNode.children.push_back({"Expr", {{"Value: 0"}}});
-        }
-        if (!match(")"))
-            throw std::runtime_error("Expected ) after for header");
-        forNode.children.push_back(parseStatement());
-        return forNode;
+        recover(*at, message, stack, values, nonterminal);
+        return;
     }
+    const Production& production = grammar.productions[entry];
+    size_t base = values.size();
+    stack.push_back({nullptr, &production, base, pos});
+    for (size_t i = production.size; i-- > 0;)
+        stack.push_back({&production.symbols[i], &production, base, pos});
+}
 
-    if (match("cout")) {
-        Node coutNode = {"Cout"};
-        if (!match("<<"))
-            throw std::runtime_error("Expected << after cout");
-        coutNode.children.push_back(parseExpression());
-        while (match("<<")) {
-            coutNode.children.push_back(parseExpression());
+// Reports an error and abandons the innermost list element being parsed
+// (`expanding`, if that is one), which becomes the error node. Its parent
+// goes on in panic mode, and the list resynchronizes after it.
+void Parser::recover(const Token& at, const std::string& message, std::vector<Frame>& stack,
+                     std::vector<ParseValue>& values, int expanding) {
+    ParseValue error;
+    error.node = fail(at, message);
+    if (expanding < 0 || !grammar.element[expanding]) {
+        bool found = false;
+        while (!stack.empty() && !found) {
+            Frame frame = stack.back();
+            stack.pop_back();
+            if (!frame.symbol && grammar.element[frame.production->lhs]) {
+                values.resize(frame.base);
+                found = true;
+            }
         }
-        if (!match(";"))
-            throw std::runtime_error("Expected ; after cout");
-        return coutNode;
+        if (!found)
+            values.clear();
     }
+    values.push_back(std::move(error));
+}
 
-    if (match("cin")) {
-        Node cinNode = {"Cin"};
-        if (!match(">>"))
-            throw std::runtime_error("Expected >> after cin");
-        do {
-            Token var = advance();
-            if (var.type != "identifier")
-                throw std::runtime_error("Expected variable after >>");
-            cinNode.children.push_back({"Var: " + var.value});
-        } while (match(">>"));
-        if (!match(";"))
-            throw std::runtime_error("Expected ; after cin");
-        return cinNode;
-    }
+Result<Node> Parser::parse() {
+    static const GrammarSymbol start = {SymbolKind::Nonterminal, 0};
+    std::vector<Frame> stack = {{&start, nullptr, 0, 0}};
+    std::vector<ParseValue> values;
+    while (!stack.empty()) {
+        Frame frame = stack.back();
+        stack.pop_back();
 
-    if (match("{")) {
-        Node block = {"Block"};
-        while (!match("}")) {
-            block.children.push_back(parseStatement());
+        if (!frame.symbol) {
+            const Production& production = *frame.production;
+            ActionContext reduced = context(frame.start);
+            ParseValue out;
+            if (production.action)
+                production.action(reduced, values.data() + frame.base, out);
+            else if (production.values == 1)
+                out = std::move(values[frame.base]);
+            values.resize(frame.base);
+            values.push_back(std::move(out));
+            continue;
         }
-        return block;
-    }
 
-    Token first = advance();
-    if (first.type == "identifier") {
-        if (match("=")) {
-            Node assign = {"Assignment"};
-            assign.children.push_back({"Var: " + first.value});
-            Node expr = parseExpression();
-            assign.children.push_back(expr);
-            
-            // Update symbol table on assignment
-            if (expr.children[0].label.substr(0, 7) == "Value: ") {
-                try {
-                    std::string val = expr.children[0].label.substr(7);
-                    int value = std::stoi(val);
-                    // Find and update the variable in symbol table
-                    for (auto& entry : symbolTable) {
-                        if (entry.name == first.value && entry.scope == currentScope) {
-                            entry.value = value;
-                            entry.hasValue = true;
-                            break;
-                        }
-                    }
-                } catch (...) {}
-            }
-            
-            if (!match(";"))
-                throw std::runtime_error("Expected ; after assignment");
-            return assign;
+        const GrammarSymbol& symbol = *frame.symbol;
+        if (symbol.kind == SymbolKind::Nonterminal) {
+            expand(frame, stack, values);
         }
-        else if (match("(")) {
-            Node call = {"FunctionCall"};
-            call.children.push_back({"Callee: " + first.value});
-            Node args = {"Arguments"};
-            if (!match(")")) {
-                do {
-                    args.children.push_back(parseExpression());
-                } while (match(","));
-                if (!match(")"))
-                    throw std::runtime_error("Expected ) after function call arguments");
-            }
-            call.children.push_back(args);
-            if (!match(";"))
-                throw std::runtime_error("Expected ; after function call");
-            return call;
+        else if (symbol.kind == SymbolKind::Action) {
+            ActionContext sofar = context(frame.start);
+            ParseValue unused;
+            symbol.action(sofar, values.data() + frame.base, unused);
+        }
+        else if (symbol.id == kAnyToken ? pos < tokens.size()
+                 : symbol.id == T_Ident ? (grammar.identifiers >> terminals[pos] & 1)
+                                        : terminals[pos] == symbol.id) {
+            values.push_back({&tokens[pos++]});
+        }
+        else {
+            const Token* at = nullptr;
+            std::string message = missing(symbol, stack, at);
+            recover(*at, message, stack, values, -1);
         }
     }
-    throw std::runtime_error("Unknown statement starting with: " + first.value);
-}
 
-Node Parser::parseExpression() {
-    Node left = parseSimpleExpression();
-    while (pos < tokens.size() && tokens[pos].type == "symbol" &&
-           (tokens[pos].value == "+" || tokens[pos].value == "-" ||
-            tokens[pos].value == "*" || tokens[pos].value == "/" ||
-            tokens[pos].value == "%" ||
-            tokens[pos].value == "==" || tokens[pos].value == "!=" ||
-            tokens[pos].value == "<" || tokens[pos].value == ">" ||
-            tokens[pos].value == "<=" || tokens[pos].value == ">=")) {
-        Token op = advance();
-        Node exprNode = {"Expr"};
-        exprNode.children.push_back(left);
-        exprNode.children.push_back({"Op: " + op.value});
-        exprNode.children.push_back(parseSimpleExpression());
-        left = exprNode;
-    }
-    return left;
+    // Number the finished tree before copying functions out, so the
+    // simulated functions carry the same node ids as tree.json
+    Node tree = values.empty() ? Node{"Program"} : std::move(values.back().node);
+    assignNodeIds(tree);
+    for (const Node& child : tree.children)
+        if (child.label == "Function")
+            allFunctions.push_back(child);
+    return {std::move(tree), diagnostics};
 }
-
-Node Parser::parseSimpleExpression() {
-    Token left = advance();
-    if (left.type == "identifier" && pos < tokens.size() && tokens[pos].value == "(") {
-        advance(); // consume '('
-        Node call = {"FunctionCall"};
-        call.children.push_back({"Callee: " + left.value});
-        Node args = {"Arguments"};
-        if (pos < tokens.size() && tokens[pos].value != ")") {
-            do {
-                args.children.push_back(parseExpression());
-            } while (match(","));
-        }
-        if (!match(")"))
-            throw std::runtime_error("Expected ) after function call arguments");
-        call.children.push_back(args);
-        return call;
-    }
-    Node exprNode = {"Expr"};
-    exprNode.children.push_back({"Value: " + left.value});
-    return exprNode;
-} 
\ No newline at end of file
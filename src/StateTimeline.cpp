@@ -0,0 +1,195 @@
+#include "StateTimeline.h"
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+json framesToJson(const std::vector<StateFrame>& frames) {
+    json out = json::array();
+    for (const auto& frame : frames) {
+        json values = json::array();
+        for (size_t slot = 0; slot < frame.values.size(); ++slot)
+            values.push_back(frame.defined[slot] ? json(frame.values[slot]) : json());
+        out.push_back({frame.function, std::move(values)});
+    }
+    return out;
+}
+
+std::vector<StateFrame> framesFromJson(const json& j) {
+    std::vector<StateFrame> frames;
+    for (const auto& f : j) {
+        StateFrame frame{f.at(0).get<uint32_t>(), {}, {}};
+        for (const auto& v : f.at(1)) {
+            frame.values.push_back(v.is_null() ? 0 : v.get<int>());
+            frame.defined.push_back(!v.is_null());
+        }
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+} // namespace
+
+void applyStateDelta(std::vector<StateFrame>& frames, const StateDelta& delta) {
+    switch (delta.kind) {
+    case StateDelta::Set: {
+        if (delta.depth >= frames.size())
+            return;
+        StateFrame& frame = frames[delta.depth];
+        if (delta.target >= frame.values.size()) {
+            frame.values.resize(delta.target + 1, 0);
+            frame.defined.resize(delta.target + 1, 0);
+        }
+        frame.values[delta.target] = delta.value;
+        frame.defined[delta.target] = 1;
+        break;
+    }
+    case StateDelta::Call:
+        frames.push_back({delta.target, {}, {}});
+        break;
+    case StateDelta::Return:
+        if (!frames.empty())
+            frames.pop_back();
+        break;
+    }
+}
+
+void StateRecorder::record(const StateDelta& delta) {
+    applyStateDelta(live, delta);
+    deltas.push_back(delta);
+    if (deltas.size() % interval == 0)
+        keyframes.push_back(live);
+}
+
+void StateRecorder::event(uint64_t ordinal) {
+    if (eventDeltas.empty())
+        firstEvent = ordinal;
+    eventDeltas.push_back(deltas.size());
+}
+
+void StateRecorder::rebase(uint64_t ordinal) {
+    uint64_t drop = ordinal > firstEvent ? std::min<uint64_t>(ordinal - firstEvent, eventDeltas.size()) : 0;
+    eventDeltas.erase(eventDeltas.begin(), eventDeltas.begin() + static_cast<std::ptrdiff_t>(drop));
+    firstEvent = 0;
+}
+
+void StateRecorder::describe(const BytecodeProgram& program) {
+    functionNames.clear();
+    slotNames.clear();
+    for (const auto& function : program.functions) {
+        functionNames.push_back(program.names[function.nameId]);
+        slotNames.emplace_back();
+        for (uint32_t nameId : function.slotNames)
+            slotNames.back().push_back(program.names[nameId]);
+    }
+}
+
+json StateRecorder::toJson() const {
+    json j;
+    j["interval"] = interval;
+    j["firstEvent"] = firstEvent;
+    j["functions"] = json::array();
+    for (size_t i = 0; i < functionNames.size(); ++i)
+        j["functions"].push_back({{"name", functionNames[i]}, {"slots", slotNames[i]}});
+    j["keyframes"] = json::array();
+    for (const auto& frames : keyframes)
+        j["keyframes"].push_back(framesToJson(frames));
+    j["deltas"] = json::array();
+    for (const auto& delta : deltas) {
+        if (delta.kind == StateDelta::Set)
+            j["deltas"].push_back({0, delta.depth, delta.target, delta.value});
+        else if (delta.kind == StateDelta::Call)
+            j["deltas"].push_back({1, delta.target});
+        else
+            j["deltas"].push_back({2});
+    }
+    j["events"] = eventDeltas;
+    return j;
+}
+
+Result<StateTimeline> loadStateTimeline(const std::string& path) {
+    Result<StateTimeline> result;
+    auto fail = [&](const std::string& message) {
+        result.diagnostics.push_back({message + ": " + path});
+        return result;
+    };
+    std::ifstream in(path);
+    json j = in ? json::parse(in, nullptr, false) : json();
+    if (!j.is_object() || !j.contains("interval") || !j["interval"].is_number_unsigned() ||
+        j["interval"].get<uint32_t>() == 0)
+        return fail("Not a state timeline");
+
+    StateTimeline& timeline = result.value;
+    try {
+        timeline.interval = j["interval"].get<uint32_t>();
+        timeline.first = j.at("firstEvent").get<uint64_t>();
+        for (const auto& function : j.at("functions")) {
+            timeline.functionNames.push_back(function.at("name").get<std::string>());
+            timeline.slotNames.push_back(function.at("slots").get<std::vector<std::string>>());
+        }
+        for (const auto& frames : j.at("keyframes"))
+            timeline.keyframes.push_back(framesFromJson(frames));
+        for (const auto& d : j.at("deltas")) {
+            int kind = d.at(0).get<int>();
+            if (kind == 0)
+                timeline.deltas.push_back({StateDelta::Set, d.at(1).get<uint32_t>(), d.at(2).get<uint32_t>(),
+                                           d.at(3).get<int>()});
+            else if (kind == 1)
+                timeline.deltas.push_back({StateDelta::Call, 0, d.at(1).get<uint32_t>(), 0});
+            else
+                timeline.deltas.push_back({StateDelta::Return, 0, 0, 0});
+        }
+        timeline.eventDeltas = j.at("events").get<std::vector<uint64_t>>();
+    }
+    catch (const json::exception&) {
+        return fail("Corrupt state timeline");
+    }
+
+    // stateAt() relies on these without checking
+    if (timeline.keyframes.empty())
+        return fail("State timeline has no keyframes");
+    for (size_t e = 0; e < timeline.eventDeltas.size(); ++e) {
+        if (timeline.eventDeltas[e] > timeline.deltas.size() ||
+            (e && timeline.eventDeltas[e] < timeline.eventDeltas[e - 1]))
+            return fail("State timeline events do not match its deltas");
+    }
+    for (const auto& frames : timeline.keyframes) {
+        for (const auto& frame : frames) {
+            if (frame.defined.size() != frame.values.size())
+                return fail("Corrupt state timeline");
+        }
+    }
+    return result;
+}
+
+Result<std::vector<StateFrame>> StateTimeline::stateAt(uint64_t ordinal) const {
+    Result<std::vector<StateFrame>> result;
+    if (ordinal < first || ordinal - first >= eventDeltas.size()) {
+        result.diagnostics.push_back({"No state recorded for trace event " + std::to_string(ordinal)});
+        return result;
+    }
+    uint64_t target = eventDeltas[ordinal - first];
+    uint64_t keyframe = target / interval;
+    if (keyframe >= keyframes.size())
+        keyframe = keyframes.size() - 1;
+    result.value = keyframes[keyframe];
+    for (uint64_t d = keyframe * interval; d < target; ++d)
+        applyStateDelta(result.value, deltas[d]);
+    return result;
+}
+
+json StateTimeline::stateToJson(const std::vector<StateFrame>& frames) const {
+    json out = json::array();
+    for (const auto& frame : frames) {
+        json variables = json::object();
+        const std::vector<std::string>* names =
+            frame.function < slotNames.size() ? &slotNames[frame.function] : nullptr;
+        for (size_t slot = 0; slot < frame.values.size(); ++slot) {
+            if (frame.defined[slot] && names && slot < names->size())
+                variables[(*names)[slot]] = frame.values[slot];
+        }
+        std::string function = frame.function < functionNames.size() ? functionNames[frame.function] : "";
+        out.push_back({{"function", function}, {"variables", std::move(variables)}});
+    }
+    return {{"frames", std::move(out)}};
+}
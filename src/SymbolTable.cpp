@@ -1,14 +1,23 @@
 #include "SymbolTable.h"
-#include <unordered_map>
+#include <charconv>
 
 std::vector<SymbolEntry> symbolTable;
 
+// Leading-integer conversion with std::stoi semantics ("3.14" -> 3), minus the exceptions.
+bool parseIntLiteral(std::string_view text, int& value) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc();
+}
+
 int evalExpr(const Node& expr, std::unordered_map<std::string, int>& vars) {
     if (expr.label == "Expr") {
         if (expr.children.size() == 1) {
             std::string val = expr.children[0].label.substr(7); // "Value: "
-            if (!val.empty() && std::isdigit(val[0]))
-                return std::stoi(val);
+            if (!val.empty() && std::isdigit(val[0])) {
+                int number = 0;
+                parseIntLiteral(val, number);
+                return number;
+            }
             if (vars.count(val))
                 return vars[val];
             return 0;
@@ -31,4 +40,18 @@ int evalExpr(const Node& expr, std::unordered_map<std::string, int>& vars) {
         }
     }
     return 0;
-} 
\ No newline at end of file
+} 
+
+json symbolTableToJson(const std::vector<SymbolEntry>& symbols) {
+    json symtab = json::array();
+    for (const auto& entry : symbols) {
+        json row;
+        row["name"] = entry.name;
+        row["type"] = entry.type;
+        row["scope"] = entry.scope;
+        if (entry.hasValue)
+            row["value"] = entry.value;
+        symtab.push_back(row);
+    }
+    return symtab;
+}
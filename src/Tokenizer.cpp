@@ -1,83 +1,84 @@
 #include "Tokenizer.h"
-#include <regex>
-#include <stdexcept>
 
-std::vector<Token> tokenize(const std::string& code) {
-    std::vector<Token> tokens;
-    std::vector<std::regex> token_patterns = {
-        std::regex("#[a-zA-Z_]+[^\\n]*"),
-        std::regex("\\bint\\b"),
-        std::regex("\\bvoid\\b"),
-        std::regex("\\bfloat\\b"),
-        std::regex("\\bdouble\\b"),
-        std::regex("\\bchar\\b"),
-        std::regex("\\bbool\\b"),
-        std::regex("\\bstring\\b"),
-        std::regex("\\breturn\\b"),
-        std::regex("\\bif\\b"),
-        std::regex("\\belse\\b"),
-        std::regex("\\bwhile\\b"),
-        std::regex("\\bfor\\b"),
-        std::regex("\\bswitch\\b"),
-        std::regex("\\bcase\\b"),
-        std::regex("\\bbreak\\b"),
-        std::regex("\\bcontinue\\b"),
-        std::regex("\\bcout\\b"),
-        std::regex("\\bcin\\b"),
-        std::regex("\\benum\\b"),
-        std::regex("\\bstruct\\b"),
-        std::regex("\\bconst\\b"),
-        std::regex("\\btrue\\b"),
-        std::regex("\\bfalse\\b"),
-        std::regex("\"[^\"]*\""),
-        std::regex("'[^']*'"),
-        std::regex("<<|>>"),
-        std::regex("==|!=|<=|>=|<|>"),
-        std::regex("[a-zA-Z_][a-zA-Z0-9_]*"),
-        std::regex("[0-9]+(\\.[0-9]+)?"),
-        std::regex("[(){};,=+*/\\-<>%.\\[\\]:]")
-    };
-
-    std::string::const_iterator it = code.begin();
-    while (it != code.end()) {
-        if (std::isspace(*it)) {
-            ++it;
+Result<std::vector<Token>> tokenize(const std::string& code, const LanguageSpec& spec) {
+    Result<std::vector<Token>> result;
+    std::vector<Token>& tokens = result.value;
+    const size_t n = code.size();
+    size_t i = 0;
+    int line = 1;
+    size_t lineStart = 0;
+    while (i < n) {
+        const char c = code[i];
+        const uint8_t cls = spec.classOf(c);
+        if (cls & CC_Space) {
+            if (c == '\n') {
+                ++line;
+                lineStart = i + 1;
+            }
+            ++i;
             continue;
         }
-        bool matched = false;
-        for (const auto& pat : token_patterns) {
-            std::smatch match;
-            if (std::regex_search(it, code.cend(), match, pat, std::regex_constants::match_continuous)) {
-                std::string val = match.str();
-                std::string type;
-                if (val == "int" || val == "void" || val == "float" || val == "double" ||
-                    val == "char" || val == "bool" || val == "string" ||
-                    val == "return" || val == "if" || val == "else" || val == "while" ||
-                    val == "for" || val == "switch" || val == "case" ||
-                    val == "break" || val == "continue" ||
-                    val == "cout" || val == "cin" || val == "enum" || val == "struct" ||
-                    val == "const" || val == "true" || val == "false")
-                    type = "keyword";
-                else if (std::regex_match(val, std::regex("#[a-zA-Z_]+[^\\n]*")))
-                    type = "preprocessor";
-                else if (std::regex_match(val, std::regex("\"[^\"]*\"")))
-                    type = "string";
-                else if (std::regex_match(val, std::regex("[0-9]+(\\.[0-9]+)?")))
-                    type = "number";
-                else if (std::regex_match(val, std::regex("[(){};,=+*/\\-<>%.\\[\\]:]")) ||
-                         val == "==" || val == "!=" || val == "<=" || val == ">=" || val == "<" || val == ">" ||
-                         val == "<<" || val == ">>")
+        const int column = static_cast<int>(i - lineStart) + 1;
+        size_t end = i;
+        std::string type;
+        if (c == spec.preprocessorMarker && i + 1 < n && (spec.classOf(code[i + 1]) & CC_IdentStart)) {
+            end = code.find('\n', i);
+            if (end == std::string::npos)
+                end = n;
+            type = "preprocessor";
+        }
+        else if (cls & CC_IdentStart) {
+            end = i + 1;
+            while (end < n && (spec.classOf(code[end]) & (CC_IdentStart | CC_Digit)))
+                ++end;
+            type = spec.keywords.contains(std::string_view(code).substr(i, end - i)) ? "keyword" : "identifier";
+        }
+        else if (cls & CC_Digit) {
+            end = i + 1;
+            while (end < n && (spec.classOf(code[end]) & CC_Digit))
+                ++end;
+            if (end + 1 < n && code[end] == '.' && (spec.classOf(code[end + 1]) & CC_Digit)) {
+                end += 2;
+                while (end < n && (spec.classOf(code[end]) & CC_Digit))
+                    ++end;
+            }
+            type = "number";
+        }
+        else if (c == spec.stringLiteral.quote || c == spec.charLiteral.quote) {
+            const QuotedLiteral& lit = (c == spec.stringLiteral.quote) ? spec.stringLiteral : spec.charLiteral;
+            size_t close = code.find(lit.quote, i + 1);
+            if (close != std::string::npos) {
+                end = close + 1;
+                type = lit.tokenType;
+            }
+        }
+        if (end == i && (cls & CC_Operator)) {
+            std::string_view rest = std::string_view(code).substr(i);
+            for (size_t k = 0; k < spec.operators.size; ++k) {
+                if (rest.substr(0, spec.operators.words[k].size()) == spec.operators.words[k]) {
+                    end = i + spec.operators.words[k].size();
                     type = "symbol";
-                else
-                    type = "identifier";
-                tokens.push_back({type, val});
-                it += val.length();
-                matched = true;
-                break;
+                    break;
+                }
+            }
+        }
+        if (end == i && (cls & CC_Symbol)) {
+            end = i + 1;
+            type = "symbol";
+        }
+        if (end == i) {
+            result.diagnostics.push_back({"Unrecognized token: " + std::string(1, c), line, column});
+            ++i;
+            continue;
+        }
+        tokens.push_back({type, code.substr(i, end - i), line, column, static_cast<uint32_t>(i)});
+        for (size_t k = i; k < end; ++k) {
+            if (code[k] == '\n') {
+                ++line;
+                lineStart = k + 1;
             }
         }
-        if (!matched)
-            throw std::runtime_error("Unrecognized token: " + std::string(it, it + 1));
+        i = end;
     }
-    return tokens;
-} 
\ No newline at end of file
+    return result;
+}
@@ -0,0 +1,356 @@
+#include "TraceDiff.h"
+#include <algorithm>
+#include <fstream>
+#include "ColumnarTrace.h"
+#include "TraceFolding.h"
+
+namespace {
+
+constexpr uint64_t kFnvOffset = 1469598103934665603ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+constexpr uint64_t kWindowBase = 0x100000001b3ull;
+constexpr size_t kMaxRegionsShown = 20;
+constexpr size_t kMaxGapEdits = 1024;          // edit distance refined inside one gap
+constexpr uint64_t kMaxGapWork = 200000000;     // and the (n + m) * d work allowed for it
+
+uint64_t eventHash(const std::string& text) {
+    uint64_t h = kFnvOffset;
+    for (unsigned char c : text) {
+        h ^= c;
+        h *= kFnvPrime;
+    }
+    return h;
+}
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::string directoryOf(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+// Hash of every window of kDiffWindow consecutive events, by start
+std::vector<uint64_t> windowHashes(const std::vector<uint64_t>& events) {
+    std::vector<uint64_t> windows;
+    if (events.size() < kDiffWindow)
+        return windows;
+    uint64_t top = 1;
+    for (size_t i = 1; i < kDiffWindow; ++i)
+        top *= kWindowBase;
+    uint64_t h = 0;
+    for (size_t i = 0; i < kDiffWindow; ++i)
+        h = h * kWindowBase + events[i];
+    windows.push_back(h);
+    for (size_t i = kDiffWindow; i < events.size(); ++i) {
+        h = (h - events[i - kDiffWindow] * top) * kWindowBase + events[i];
+        windows.push_back(h);
+    }
+    return windows;
+}
+
+struct Anchor {
+    uint64_t a, b;
+};
+
+// Windows occurring exactly once in each trace, in order of `a`. Sorting
+// (hash, position) pairs beats hash maps at millions of windows.
+std::vector<Anchor> uniqueAnchors(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+    auto sortedWindows = [](const std::vector<uint64_t>& events) {
+        std::vector<std::pair<uint64_t, uint64_t>> windows;
+        std::vector<uint64_t> hashes = windowHashes(events);
+        windows.reserve(hashes.size());
+        for (size_t i = 0; i < hashes.size(); ++i)
+            windows.emplace_back(hashes[i], i);
+        std::sort(windows.begin(), windows.end());
+        return windows;
+    };
+    std::vector<std::pair<uint64_t, uint64_t>> wa = sortedWindows(a), wb = sortedWindows(b);
+
+    constexpr uint64_t kUnmatched = UINT64_MAX;
+    std::vector<uint64_t> match(wa.size(), kUnmatched);    // window of a -> window of b
+    size_t i = 0, j = 0;
+    while (i < wa.size() && j < wb.size()) {
+        uint64_t h = std::min(wa[i].first, wb[j].first);
+        size_t ia = i, jb = j;
+        while (i < wa.size() && wa[i].first == h)
+            ++i;
+        while (j < wb.size() && wb[j].first == h)
+            ++j;
+        if (i - ia == 1 && j - jb == 1)
+            match[wa[ia].second] = wb[jb].second;
+    }
+    std::vector<Anchor> anchors;
+    for (size_t pa = 0; pa < match.size(); ++pa) {
+        if (match[pa] != kUnmatched)
+            anchors.push_back({pa, match[pa]});
+    }
+    return anchors;
+}
+
+// Longest subsequence of anchors increasing in both traces
+std::vector<Anchor> increasingAnchors(const std::vector<Anchor>& anchors) {
+    std::vector<size_t> tails, previous(anchors.size(), SIZE_MAX);
+    for (size_t i = 0; i < anchors.size(); ++i) {
+        auto it = std::lower_bound(tails.begin(), tails.end(), anchors[i].b,
+                                   [&](size_t t, uint64_t b) { return anchors[t].b < b; });
+        if (it != tails.begin())
+            previous[i] = *(it - 1);
+        if (it == tails.end())
+            tails.push_back(i);
+        else
+            *it = i;
+    }
+    std::vector<Anchor> chain;
+    for (size_t i = tails.empty() ? SIZE_MAX : tails.back(); i != SIZE_MAX; i = previous[i])
+        chain.push_back(anchors[i]);
+    std::reverse(chain.begin(), chain.end());
+    return chain;
+}
+
+// Myers' O((n + m) d) diff of one gap between anchors, appended as the
+// regions between its matching runs. Returns false when the gap needs more
+// than `maxEdits` edits, leaving the caller to report it whole.
+bool refineGap(const uint64_t* a, size_t n, const uint64_t* b, size_t m, uint64_t aBase, uint64_t bBase,
+               size_t maxEdits, std::vector<TraceRegion>& out) {
+    const ptrdiff_t offset = static_cast<ptrdiff_t>(maxEdits) + 1;
+    std::vector<ptrdiff_t> v(2 * maxEdits + 3, 0);
+    std::vector<std::vector<ptrdiff_t>> history;    // v before step d, for k in [-d, d]
+    ptrdiff_t N = static_cast<ptrdiff_t>(n), M = static_cast<ptrdiff_t>(m);
+    ptrdiff_t found = -1;
+    for (ptrdiff_t d = 0; d <= static_cast<ptrdiff_t>(maxEdits) && found < 0; ++d) {
+        history.emplace_back(v.begin() + offset - d - 1, v.begin() + offset + d + 2);
+        for (ptrdiff_t k = -d; k <= d; k += 2) {
+            ptrdiff_t x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+                              ? v[offset + k + 1] : v[offset + k - 1] + 1;
+            ptrdiff_t y = x - k;
+            while (x < N && y < M && a[x] == b[y]) {
+                ++x;
+                ++y;
+            }
+            v[offset + k] = x;
+            if (x >= N && y >= M) {
+                found = d;
+                break;
+            }
+        }
+    }
+    if (found < 0)
+        return false;
+
+    // Walk back collecting edits, then group adjacent edits into regions
+    struct Edit {
+        ptrdiff_t x, y;
+        bool insert;
+    };
+    std::vector<Edit> edits;
+    ptrdiff_t x = N, y = M;
+    for (ptrdiff_t d = found; d > 0; --d) {
+        const std::vector<ptrdiff_t>& prev = history[d];
+        auto at = [&](ptrdiff_t k) { return prev[k + d + 1]; };
+        ptrdiff_t k = x - y;
+        ptrdiff_t prevK = (k == -d || (k != d && at(k - 1) < at(k + 1))) ? k + 1 : k - 1;
+        ptrdiff_t prevX = at(prevK), prevY = prevX - prevK;
+        edits.push_back({prevX, prevY, prevK == k + 1});
+        x = prevX;
+        y = prevY;
+    }
+    std::reverse(edits.begin(), edits.end());
+    for (size_t i = 0; i < edits.size();) {
+        ptrdiff_t x0 = edits[i].x, y0 = edits[i].y, x1 = x0, y1 = y0;
+        for (; i < edits.size() && edits[i].x == x1 && edits[i].y == y1; ++i) {
+            if (edits[i].insert)
+                ++y1;
+            else
+                ++x1;
+        }
+        out.push_back({aBase + x0, aBase + x1, bBase + y0, bBase + y1});
+    }
+    return true;
+}
+
+void addGap(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b, uint64_t aBegin, uint64_t aEnd,
+            uint64_t bBegin, uint64_t bEnd, std::vector<TraceRegion>& out) {
+    uint64_t size = (aEnd - aBegin) + (bEnd - bBegin);
+    size_t maxEdits = static_cast<size_t>(std::min<uint64_t>(kMaxGapEdits, kMaxGapWork / size));
+    if (!refineGap(a.data() + aBegin, aEnd - aBegin, b.data() + bBegin, bEnd - bBegin, aBegin, bBegin,
+                   maxEdits, out))
+        out.push_back({aBegin, aEnd, bBegin, bEnd});
+}
+
+} // namespace
+
+TraceDiff diffTraces(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+    TraceDiff diff;
+    uint64_t ai = 0, bi = 0;
+    while (ai < a.size() && bi < b.size() && a[ai] == b[bi]) {
+        ++ai;
+        ++bi;
+    }
+    if (ai == a.size() && bi == b.size())
+        return diff;
+    diff.identical = false;
+    diff.firstDivergence = ai;
+
+    uint64_t aEnd = a.size(), bEnd = b.size();
+    while (aEnd > ai && bEnd > bi && a[aEnd - 1] == b[bEnd - 1]) {
+        --aEnd;
+        --bEnd;
+    }
+
+    for (Anchor anchor : increasingAnchors(uniqueAnchors(a, b))) {
+        uint64_t pa = anchor.a, pb = anchor.b;
+        if (pa < ai || pb < bi || pa >= aEnd || pb >= bEnd || a[pa] != b[pb])
+            continue;       // already matched, outside the middle, or a collision
+        while (pa > ai && pb > bi && a[pa - 1] == b[pb - 1]) {
+            --pa;
+            --pb;
+        }
+        if (pa > ai || pb > bi)
+            addGap(a, b, ai, pa, bi, pb, diff.regions);
+        while (pa < aEnd && pb < bEnd && a[pa] == b[pb]) {
+            ++pa;
+            ++pb;
+        }
+        ai = pa;
+        bi = pb;
+    }
+    if (ai < aEnd || bi < bEnd)
+        addGap(a, b, ai, aEnd, bi, bEnd, diff.regions);
+    return diff;
+}
+
+namespace {
+
+// Chunks listed by a manifest hold events, never another manifest
+Result<std::vector<std::string>> loadEvents(const std::string& path, bool chunk) {
+    Result<std::vector<std::string>> result;
+    auto& events = result.value;
+    auto fail = [&](const std::string& message) {
+        result.diagnostics.push_back({message + ": " + path});
+        return result;
+    };
+
+    if (endsWith(path, ".columns")) {
+        auto columnar = openColumnarTrace(path);
+        if (!columnar.ok()) {
+            result.diagnostics = std::move(columnar.diagnostics);
+            return result;
+        }
+        auto all = columnarTraceToJson(columnar.value);
+        if (!all.ok()) {
+            result.diagnostics = std::move(all.diagnostics);
+            return result;
+        }
+        // Strings come straight from the file, so they may not be UTF-8
+        for (const auto& event : all.value)
+            events.push_back(event.dump(-1, ' ', false, json::error_handler_t::replace));
+        return result;
+    }
+
+    std::ifstream in(path);
+    if (!in)
+        return fail("Cannot open trace");
+    if (endsWith(path, ".ndjson")) {
+        // Lines are already compact JSON as TraceWriter writes them
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty())
+                events.push_back(line);
+        }
+        return result;
+    }
+
+    json document = json::parse(in, nullptr, false);
+    if (document.is_discarded())
+        return fail("Not a JSON trace");
+    if (document.is_object() && document.contains("chunks")) {
+        const json& chunks = document["chunks"];
+        if (chunk || !chunks.is_array())
+            return fail("Not a trace manifest");
+        for (const auto& entry : chunks) {
+            if (!entry.is_object() || !entry.contains("file") || !entry["file"].is_string())
+                return fail("Manifest chunk without a file");
+            auto part = loadEvents(directoryOf(path) + "/" + entry["file"].get<std::string>(), true);
+            if (!part.ok())
+                return part;
+            events.insert(events.end(), std::make_move_iterator(part.value.begin()),
+                          std::make_move_iterator(part.value.end()));
+        }
+        return result;
+    }
+    if (!document.is_array())
+        return fail("Not a JSON trace");
+    auto expanded = expandTrace(document);
+    if (!expanded.ok())
+        return fail(expanded.diagnostics.front().message);
+    for (const auto& event : expanded.value)
+        events.push_back(event.dump());
+    return result;
+}
+
+} // namespace
+
+Result<std::vector<std::string>> loadTraceEvents(const std::string& path) {
+    // Trace files may be truncated or edited by hand; report whatever the
+    // checks above miss rather than let a json exception escape
+    try {
+        return loadEvents(path, false);
+    }
+    catch (const std::exception& e) {
+        Result<std::vector<std::string>> result;
+        result.diagnostics.push_back({std::string(e.what()) + ": " + path});
+        return result;
+    }
+}
+
+int runTraceDiff(const std::string& first, const std::string& second, std::ostream& out) {
+    auto a = loadTraceEvents(first);
+    auto b = loadTraceEvents(second);
+    if (!a.ok() || !b.ok()) {
+        for (const auto* loaded : {&a, &b}) {
+            for (const auto& d : loaded->diagnostics)
+                out << "Error: " << d.message << "\n";
+        }
+        return 2;
+    }
+
+    std::vector<uint64_t> ha, hb;
+    ha.reserve(a.value.size());
+    hb.reserve(b.value.size());
+    for (const auto& event : a.value)
+        ha.push_back(eventHash(event));
+    for (const auto& event : b.value)
+        hb.push_back(eventHash(event));
+
+    TraceDiff diff = diffTraces(ha, hb);
+    out << first << ": " << a.value.size() << " events\n"
+        << second << ": " << b.value.size() << " events\n";
+    if (diff.identical) {
+        out << "Traces are identical.\n";
+        return 0;
+    }
+
+    auto eventAt = [](const std::vector<std::string>& events, uint64_t i) {
+        return i < events.size() ? events[i] : std::string("(end of trace)");
+    };
+    out << "First divergence at event " << diff.firstDivergence << ":\n"
+        << "  - " << eventAt(a.value, diff.firstDivergence) << "\n"
+        << "  + " << eventAt(b.value, diff.firstDivergence) << "\n";
+
+    uint64_t removed = 0, added = 0;
+    for (const auto& region : diff.regions) {
+        removed += region.aEnd - region.aBegin;
+        added += region.bEnd - region.bBegin;
+    }
+    out << diff.regions.size() << " changed region(s), " << removed << " event(s) removed, "
+        << added << " added:\n";
+    for (size_t i = 0; i < diff.regions.size() && i < kMaxRegionsShown; ++i) {
+        const TraceRegion& r = diff.regions[i];
+        out << "  [" << r.aBegin << ", " << r.aEnd << ") -> [" << r.bBegin << ", " << r.bEnd << ")\n";
+    }
+    if (diff.regions.size() > kMaxRegionsShown)
+        out << "  ... " << diff.regions.size() - kMaxRegionsShown << " more\n";
+    return 1;
+}
@@ -0,0 +1,177 @@
+#include "TraceFolding.h"
+#include "TraceGenerator.h"
+#include <string>
+
+namespace {
+
+constexpr uint64_t kHashBase = 0x100000001b3ull;
+constexpr int kMaxPasses = 8;
+
+uint64_t mix(uint64_t h, uint64_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    return h;
+}
+
+// Values only distinguish events when they are written out
+uint64_t eventHash(const TraceEvent& e, bool values) {
+    uint64_t h = mix(static_cast<uint64_t>(e.action), e.branch);
+    h = mix(h, e.name);
+    h = mix(h, e.node);
+    return values ? mix(h, static_cast<uint32_t>(e.value)) : h;
+}
+
+bool sameEvent(const TraceEvent& a, const TraceEvent& b, bool values) {
+    return a.action == b.action && a.branch == b.branch && a.name == b.name && a.node == b.node &&
+           (!values || a.value == b.value);
+}
+
+bool sameRun(const TraceRun& a, const TraceRun& b, const TraceBuffer& buffer, bool values) {
+    if (a.hash != b.hash || a.repeat != b.repeat || a.body.size() != b.body.size())
+        return false;
+    if (a.body.empty())
+        return sameEvent(buffer[a.event], buffer[b.event], values);
+    for (size_t i = 0; i < a.body.size(); ++i) {
+        if (!sameRun(a.body[i], b.body[i], buffer, values))
+            return false;
+    }
+    return true;
+}
+
+TraceRun makeBlock(std::vector<TraceRun> body, uint32_t repeat) {
+    uint64_t h = mix(0xb10c, repeat);
+    for (const auto& run : body)
+        h = mix(h, run.hash);
+    return {repeat, h, 0, std::move(body)};
+}
+
+// One folding pass over `runs`. Window equality is decided with prefix
+// hashes and confirmed structurally before folding, so collisions can
+// never lose information.
+bool foldPass(std::vector<TraceRun>& runs, size_t maxPeriod, const TraceBuffer& buffer, bool values) {
+    const size_t n = runs.size();
+    std::vector<uint64_t> prefix(n + 1, 0), power(n + 1, 1);
+    for (size_t i = 0; i < n; ++i) {
+        prefix[i + 1] = prefix[i] * kHashBase + runs[i].hash;
+        power[i + 1] = power[i] * kHashBase;
+    }
+    auto window = [&](size_t start, size_t len) {
+        return prefix[start + len] - prefix[start] * power[len];
+    };
+    auto sameWindow = [&](size_t a, size_t b, size_t len) {
+        for (size_t k = 0; k < len; ++k) {
+            if (!sameRun(runs[a + k], runs[b + k], buffer, values))
+                return false;
+        }
+        return true;
+    };
+
+    std::vector<TraceRun> out;
+    out.reserve(n);
+    bool changed = false;
+    size_t i = 0;
+    while (i < n) {
+        size_t bestPeriod = 0, bestRepeat = 1;
+        for (size_t p = 1; p <= maxPeriod && i + 2 * p <= n; ++p) {
+            uint64_t h = window(i, p);
+            size_t r = 1;
+            while (i + (r + 1) * p <= n && window(i + r * p, p) == h)
+                ++r;
+            if (r >= 2 && r * p > bestRepeat * bestPeriod) {
+                bestPeriod = p;
+                bestRepeat = r;
+            }
+        }
+        if (bestPeriod) {
+            size_t r = 1;
+            while (r < bestRepeat && sameWindow(i, i + r * bestPeriod, bestPeriod))
+                ++r;
+            bestRepeat = r;
+        }
+        if (bestPeriod && bestRepeat >= 2) {
+            std::vector<TraceRun> body(std::make_move_iterator(runs.begin() + i),
+                                       std::make_move_iterator(runs.begin() + i + bestPeriod));
+            out.push_back(makeBlock(std::move(body), static_cast<uint32_t>(bestRepeat)));
+            i += bestRepeat * bestPeriod;
+            changed = true;
+        }
+        else {
+            out.push_back(std::move(runs[i]));
+            ++i;
+        }
+    }
+    runs.swap(out);
+    return changed;
+}
+
+void appendRuns(json& out, const std::vector<TraceRun>& runs, const TraceBuffer& buffer, bool values) {
+    for (const auto& run : runs) {
+        if (run.body.empty()) {
+            out.push_back(traceEventToJson(buffer[run.event], buffer.names, values));
+            continue;
+        }
+        json block;
+        block["repeat"] = run.repeat;
+        block["events"] = json::array();
+        appendRuns(block["events"], run.body, buffer, values);
+        out.push_back(std::move(block));
+    }
+}
+
+// Appends the expansion of `events` to `out`; false, with `error` set,
+// for anything but an array of events and well-formed blocks
+bool expandInto(json& out, const json& events, std::string& error) {
+    if (!events.is_array()) {
+        error = "Folded trace events must be an array";
+        return false;
+    }
+    for (const auto& item : events) {
+        if (!item.is_object()) {
+            error = "Trace event is not an object";
+            return false;
+        }
+        if (!item.contains("repeat")) {
+            out.push_back(item);
+            continue;
+        }
+        const json& repeat = item["repeat"];
+        if (!repeat.is_number_unsigned() || repeat.get<uint64_t>() > UINT32_MAX) {
+            error = "Folded block has an invalid repeat count";
+            return false;
+        }
+        if (!item.contains("events")) {
+            error = "Folded block has no events";
+            return false;
+        }
+        for (uint64_t r = 0, n = repeat.get<uint64_t>(); r < n; ++r) {
+            if (!expandInto(out, item["events"], error))
+                return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+std::vector<TraceRun> foldTrace(const TraceBuffer& buffer, size_t maxPeriod, bool values) {
+    std::vector<TraceRun> runs;
+    runs.reserve(buffer.retained());
+    for (size_t i = 0; i < buffer.retained(); ++i)
+        runs.push_back({1, eventHash(buffer[i], values), i, {}});
+    for (int pass = 0; pass < kMaxPasses && foldPass(runs, maxPeriod, buffer, values); ++pass) {
+    }
+    return runs;
+}
+
+json foldedTraceToJson(const std::vector<TraceRun>& runs, const TraceBuffer& buffer, bool values) {
+    json out = json::array();
+    appendRuns(out, runs, buffer, values);
+    return out;
+}
+
+Result<json> expandTrace(const json& events) {
+    Result<json> result{json::array(), {}};
+    std::string error;
+    if (!expandInto(result.value, events, error))
+        result.diagnostics.push_back({error});
+    return result;
+}
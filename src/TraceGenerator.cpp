@@ -1,143 +1,104 @@
 #include "TraceGenerator.h"
 #include "Parser.h"
-#include "SymbolTable.h"
+#include "Bytecode.h"
+#include "VM.h"
 
-std::vector<json> trace;
+TraceBuffer trace;
 
-void simulateExecution(const Node& node, std::unordered_map<std::string, int>& vars) {
-    if (node.label == "Function") {
-        std::string funcName;
-        for (const auto& child : node.children) {
-            if (child.label.rfind("FunctionName:", 0) == 0) {
-                funcName = child.label.substr(13);
-                break;
-            }
-        }
-        if (!funcName.empty()) {
-            trace.push_back({{"action", "call"}, {"function", funcName}});
-            for (const auto& child : node.children) {
-                if (child.label == "Body") {
-                    for (const auto& stmt : child.children) {
-                        simulateExecution(stmt, vars);
-                    }
-                }
-            }
-            trace.push_back({{"action", "return"}, {"function", funcName}});
-        }
-    }
-    else if (node.label == "VarDecl") {
-        std::string var;
-        if (!node.children.empty()) {
-            std::string decl = node.children[0].label;
-            size_t space = decl.find(' ');
-            var = (space != std::string::npos) ? decl.substr(space + 1) : decl;
-        }
-        int val = 0;
-        if (node.children.size() > 1)
-            val = evalExpr(node.children[1], vars);
-        vars[var] = val;
-        trace.push_back({{"action", "vardecl"}, {"variable", var}});
-    }
-    else if (node.label == "Assignment") {
-        std::string var;
-        if (!node.children.empty())
-            var = node.children[0].label.substr(5); // "Var: "
-        int val = 0;
-        if (node.children.size() > 1)
-            val = evalExpr(node.children[1], vars);
-        vars[var] = val;
-        trace.push_back({{"action", "assign"}, {"variable", var}});
-    }
-    else if (node.label == "Return") {
-        trace.push_back({{"action", "return_stmt"}});
-        if (!node.children.empty())
-            evalExpr(node.children[0], vars);
-    }
-    else if (node.label == "If") {
-        trace.push_back({{"action", "if_enter"}});
-        bool conditionTrue = false;
-        if (!node.children.empty())
-            conditionTrue = evalExpr(node.children[0], vars);
-        if (conditionTrue) {
-            trace.push_back({{"action", "if_taken"}, {"branch", "then"}});
-            if (node.children.size() > 1)
-                simulateExecution(node.children[1], vars);
-        }
-        else {
-            trace.push_back({{"action", "if_taken"}, {"branch", "else"}});
-            if (node.children.size() > 2)
-                simulateExecution(node.children[2], vars);
-        }
-    }
-    else if (node.label == "While") {
-        trace.push_back({{"action", "while_enter"}});
-        int loopCount = 0;
-        while (evalExpr(node.children[0], vars) && loopCount < 10) {
-            if (node.children.size() > 1)
-                simulateExecution(node.children[1], vars);
-            loopCount++;
-        }
-    }
-    else if (node.label == "For") {
-        trace.push_back({{"action", "for_enter"}});
-        std::unordered_map<std::string, int> localVars = vars;
-        if (!node.children.empty())
-            simulateExecution(node.children[0], localVars);
-        int loopCount = 0;
-        while ((node.children.size() > 1 ? evalExpr(node.children[1], localVars) : true) && loopCount < 10) {
-            if (node.children.size() > 3)
-                simulateExecution(node.children[3], localVars);
-            if (node.children.size() > 2)
-                simulateExecution(node.children[2], localVars);
-            loopCount++;
-        }
-        for (const auto& kv : localVars)
-            vars[kv.first] = kv.second;
+uint32_t StringPool::intern(const std::string& s) {
+    auto it = ids.find(s);
+    if (it != ids.end())
+        return it->second;
+    uint32_t id = static_cast<uint32_t>(strings.size());
+    strings.push_back(s);
+    ids.emplace(s, id);
+    return id;
+}
+
+const char* traceActionName(TraceAction action) {
+    switch (action) {
+    case TraceAction::Call: return "call";
+    case TraceAction::Return: return "return";
+    case TraceAction::ReturnStmt: return "return_stmt";
+    case TraceAction::VarDecl: return "vardecl";
+    case TraceAction::Assign: return "assign";
+    case TraceAction::IfEnter: return "if_enter";
+    case TraceAction::IfTaken: return "if_taken";
+    case TraceAction::WhileEnter: return "while_enter";
+    case TraceAction::ForEnter: return "for_enter";
+    case TraceAction::Cout: return "cout";
+    case TraceAction::Cin: return "cin";
+    case TraceAction::BudgetExhausted: return "budget_exhausted";
     }
-    else if (node.label == "Cout") {
-        trace.push_back({{"action", "cout"}});
-        for (const auto& child : node.children)
-            evalExpr(child, vars);
+    return "";
+}
+
+const char* traceEventField(TraceAction action) {
+    switch (action) {
+    case TraceAction::Call:
+    case TraceAction::Return:
+        return "function";
+    case TraceAction::VarDecl:
+    case TraceAction::Assign:
+        return "variable";
+    case TraceAction::IfTaken:
+        return "branch";
+    case TraceAction::BudgetExhausted:
+        return "limit";
+    default:
+        return nullptr;
     }
-    else if (node.label == "Cin") {
-        trace.push_back({{"action", "cin"}});
-        for (const auto& child : node.children) {
-            if (child.label.rfind("Var: ", 0) == 0) {
-                std::string var = child.label.substr(5);
-                if (vars.count(var) == 0)
-                    vars[var] = 5;
-            }
-        }
+}
+
+json traceEventToJson(const TraceEvent& event, const StringPool& names, bool values) {
+    json j = {{"action", traceActionName(event.action)}};
+    if (event.node != kNoNode)
+        j["node"] = event.node;
+    if (values && traceEventHasValue(event.action))
+        j["value"] = event.value;
+    if (const char* field = traceEventField(event.action)) {
+        if (event.action == TraceAction::IfTaken)
+            j[field] = event.branch ? "then" : "else";
+        else
+            j[field] = names[event.name];
     }
-    else if (node.label == "FunctionCall") {
-        std::string callee;
-        for (const auto& child : node.children) {
-            if (child.label.rfind("Callee:", 0) == 0) {
-                callee = child.label.substr(7);
-                break;
-            }
-        }
-        if (!callee.empty()) {
-            trace.push_back({{"action", "call"}, {"function", callee}});
-            for (const auto& func : allFunctions) {
-                std::string fname;
-                for (const auto& fchild : func.children) {
-                    if (fchild.label.rfind("FunctionName:", 0) == 0) {
-                        fname = fchild.label.substr(13);
-                        break;
-                    }
-                }
-                if (fname == callee) {
-                    simulateExecution(func, vars);
-                    break;
-                }
-            }
-            trace.push_back({{"action", "return"}, {"function", callee}});
+    return j;
+}
+
+json traceToJson(const TraceBuffer& buffer, bool values) {
+    json j = json::array();
+    for (size_t i = 0; i < buffer.retained(); ++i)
+        j.push_back(traceEventToJson(buffer[i], buffer.names, values));
+    return j;
+}
+
+ExecutionStatus simulateExecution(const Node& node, std::unordered_map<std::string, int>& vars,
+                                  const ExecutionBudget& budget, const TracePolicy& policy,
+                                  StateRecorder* states) {
+    BytecodeProgram program = compileProgram(allFunctions);
+    uint32_t entry = compileEntry(program, node);
+
+    // `vars` is the scope the entry statement runs in: bind it by slot
+    const BytecodeFunction& scope = program.functions[entry];
+    VariableStore store;
+    store.resize(scope.slotCount());
+    for (uint32_t slot = 0; slot < scope.slotCount(); ++slot) {
+        auto it = vars.find(program.names[scope.slotNames[slot]]);
+        if (it != vars.end()) {
+            store.values[slot] = it->second;
+            store.defined[slot] = 1;
         }
     }
-    else {
-        for (const auto& child : node.children) {
-            simulateExecution(child, vars);
-        }
+
+    VM vm(program, budget, policy);
+    vm.recordStates(states);
+    ExecutionStatus status = vm.run(entry, store);
+    if (states)
+        states->describe(program);
+
+    for (uint32_t slot = 0; slot < scope.slotCount(); ++slot) {
+        if (store.defined[slot])
+            vars[program.names[scope.slotNames[slot]]] = store.values[slot];
     }
-} 
\ No newline at end of file
+    return status;
+}
@@ -0,0 +1,195 @@
+#include "TraceIndex.h"
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+void addTo(std::vector<std::vector<uint64_t>>& lists, uint32_t name, uint64_t ordinal) {
+    if (name >= lists.size())
+        lists.resize(name + 1);
+    lists[name].push_back(ordinal);
+}
+
+json listsToJson(const std::vector<std::vector<uint64_t>>& lists, const StringPool& names) {
+    json out = json::object();
+    for (size_t id = 0; id < lists.size(); ++id) {
+        if (!lists[id].empty())
+            out[names[static_cast<uint32_t>(id)]] = lists[id];
+    }
+    return out;
+}
+
+void listsFromJson(const json& j, std::unordered_map<std::string, std::vector<uint64_t>>& lists) {
+    for (auto it = j.begin(); it != j.end(); ++it)
+        lists[it.key()] = it.value().get<std::vector<uint64_t>>();
+}
+
+// What readTraceEvent relies on: files in event order starting with event
+// 0, an offset for every kStride-th event, and offsets that only grow
+// within one file
+bool consistent(const TraceIndex& index) {
+    const uint64_t samples = (index.events + TraceIndex::kStride - 1) / TraceIndex::kStride;
+    if (index.offsets.size() < samples)
+        return false;
+    if (index.events == 0)
+        return true;
+    if (index.files.empty() || index.files.front().first != 0)
+        return false;
+    for (size_t i = 1; i < index.files.size(); ++i) {
+        if (index.files[i].first <= index.files[i - 1].first || index.files[i].first >= index.events)
+            return false;
+    }
+    size_t file = 0;
+    uint64_t previous = 0;
+    for (uint64_t k = 0; k < samples; ++k) {
+        uint64_t ordinal = k * TraceIndex::kStride;
+        bool sameFile = k > 0;
+        while (file + 1 < index.files.size() && index.files[file + 1].first <= ordinal) {
+            ++file;
+            sameFile = false;
+        }
+        uint64_t lowest = sameFile ? previous + 1 : index.files[file].offset;
+        if (index.offsets[k] < lowest)
+            return false;
+        previous = index.offsets[k];
+    }
+    return true;
+}
+
+const std::vector<uint64_t>& lookup(const std::unordered_map<std::string, std::vector<uint64_t>>& lists,
+                                    const std::string& name) {
+    static const std::vector<uint64_t> none;
+    auto it = lists.find(name);
+    return it != lists.end() ? it->second : none;
+}
+
+// Skips the separator between two events: JSON array commas or newlines
+void skipSeparator(std::istream& in) {
+    while (in) {
+        int c = in.peek();
+        if (c != ',' && c != ' ' && c != '\n' && c != '\r' && c != '\t')
+            break;
+        in.get();
+    }
+}
+
+} // namespace
+
+void TraceIndexBuilder::beginFile(const std::string& path) {
+    files.push_back({path, events, 0});
+    fileStarted = false;
+}
+
+void TraceIndexBuilder::add(uint64_t ordinal, const TraceEvent& event, uint64_t offset) {
+    if (!fileStarted) {
+        files.back().first = ordinal;
+        files.back().offset = offset;
+        fileStarted = true;
+    }
+    if (ordinal % TraceIndex::kStride == 0)
+        offsets.push_back(offset);
+    switch (event.action) {
+    case TraceAction::Call:
+    case TraceAction::Return:
+        addTo(functions, event.name, ordinal);
+        break;
+    case TraceAction::VarDecl:
+    case TraceAction::Assign:
+        addTo(variables, event.name, ordinal);
+        break;
+    default:
+        break;
+    }
+    events = ordinal + 1;
+}
+
+json TraceIndexBuilder::toJson(const StringPool& names) const {
+    json j;
+    j["events"] = events;
+    j["stride"] = TraceIndex::kStride;
+    j["files"] = json::array();
+    for (const auto& file : files)
+        j["files"].push_back({{"file", file.path}, {"first", file.first}, {"offset", file.offset}});
+    j["offsets"] = offsets;
+    j["functions"] = listsToJson(functions, names);
+    j["variables"] = listsToJson(variables, names);
+    return j;
+}
+
+Result<TraceIndex> loadTraceIndex(const std::string& path) {
+    Result<TraceIndex> result;
+    std::ifstream in(path);
+    if (!in) {
+        result.diagnostics.push_back({"Cannot open trace index " + path});
+        return result;
+    }
+    json j = json::parse(in, nullptr, false);
+    if (j.is_discarded() || j.value("stride", uint64_t(0)) != TraceIndex::kStride) {
+        result.diagnostics.push_back({"Not a trace index: " + path});
+        return result;
+    }
+    TraceIndex& index = result.value;
+    try {
+        index.events = j.at("events").get<uint64_t>();
+        for (const auto& file : j.at("files"))
+            index.files.push_back({file.at("file").get<std::string>(), file.at("first").get<uint64_t>(),
+                                   file.at("offset").get<uint64_t>()});
+        index.offsets = j.at("offsets").get<std::vector<uint64_t>>();
+        listsFromJson(j.at("functions"), index.functions);
+        listsFromJson(j.at("variables"), index.variables);
+    }
+    catch (const json::exception&) {
+        result.diagnostics.push_back({"Not a trace index: " + path});
+        return result;
+    }
+    if (!consistent(index))
+        result.diagnostics.push_back({"Trace index is inconsistent: " + path});
+    return result;
+}
+
+const std::vector<uint64_t>& functionEvents(const TraceIndex& index, const std::string& name) {
+    return lookup(index.functions, name);
+}
+
+const std::vector<uint64_t>& variableEvents(const TraceIndex& index, const std::string& name) {
+    return lookup(index.variables, name);
+}
+
+Result<json> readTraceEvent(const TraceIndex& index, uint64_t ordinal, const std::string& directory) {
+    Result<json> result;
+    if (ordinal >= index.events || index.files.empty() || index.files.front().first > ordinal) {
+        result.diagnostics.push_back({"Trace event " + std::to_string(ordinal) + " is out of range"});
+        return result;
+    }
+    // Last file starting at or before the event
+    auto file = std::upper_bound(index.files.begin(), index.files.end(), ordinal,
+                                 [](uint64_t e, const TraceIndex::File& f) { return e < f.first; }) - 1;
+
+    // Nearest indexed event at or before `ordinal` within that file
+    uint64_t at = file->first, offset = file->offset;
+    uint64_t sample = ordinal / TraceIndex::kStride * TraceIndex::kStride;
+    if (sample > at && sample / TraceIndex::kStride < index.offsets.size()) {
+        at = sample;
+        offset = index.offsets[sample / TraceIndex::kStride];
+    }
+
+    std::ifstream in(directory + "/" + file->path);
+    if (!in) {
+        result.diagnostics.push_back({"Cannot open trace file " + file->path});
+        return result;
+    }
+    in.seekg(static_cast<std::streamoff>(offset));
+    json event;
+    try {
+        for (; at <= ordinal; ++at) {
+            in >> event;
+            skipSeparator(in);
+        }
+    }
+    catch (const json::exception&) {
+        result.diagnostics.push_back({"Trace file " + file->path + " does not match its index"});
+        return result;
+    }
+    result.value = std::move(event);
+    return result;
+}
@@ -0,0 +1,231 @@
+#include "TraceWriter.h"
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include "json.hpp"
+#include "TraceFolding.h"
+
+using json = nlohmann::json;
+
+TraceWriter::TraceWriter(const TraceWriterOptions& options) : options(options) {}
+
+TraceWriter::~TraceWriter() {
+    finish();
+}
+
+std::string TraceWriter::extension() const {
+    if (options.format == TraceFormat::Columnar)
+        return ".columns";
+    return options.format == TraceFormat::NdJson ? ".ndjson" : ".json";
+}
+
+std::string TraceWriter::outputPath() const {
+    if (options.chunkEvents)
+        return options.basePath + ".manifest.json";
+    return options.basePath + extension();
+}
+
+void TraceWriter::openFile() {
+    std::string path = options.basePath + extension();
+    if (options.chunkEvents) {
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), ".%04zu", chunks.size());
+        path = options.basePath + suffix + extension();
+        chunks.push_back({path, events, 0, 0});
+    }
+    sink.reset(new BufferedSink(path, options.atomic));
+    if (options.index)
+        index.beginFile(path);
+    if (options.format == TraceFormat::Json)
+        sink->put('[');
+    inFile = 0;
+}
+
+void TraceWriter::closeFile() {
+    if (!sink)
+        return;
+    if (options.format == TraceFormat::Json)
+        sink->write(inFile ? "\n]" : "]");
+    sink->close();
+    failed = failed || !sink->ok();
+    if (!chunks.empty()) {
+        chunks.back().count = inFile;
+        chunks.back().bytes = sink->bytesWritten();
+    }
+    sink.reset();
+}
+
+void TraceWriter::write(const TraceEvent& event, const StringPool& names) {
+    this->names = &names;
+    if (options.format == TraceFormat::Columnar) {
+        // Columns are encoded as a whole when the trace is finished
+        columns.add(event);
+        ++events;
+        return;
+    }
+    if (!sink || (options.chunkEvents && inFile == options.chunkEvents)) {
+        closeFile();
+        openFile();
+    }
+
+    if (options.index) {
+        // Offset of the event's opening brace, past the separator written below
+        uint64_t offset = sink->bytesWritten();
+        if (options.format == TraceFormat::Json)
+            offset += inFile ? 6 : 5;
+        index.add(events, event, offset);
+    }
+
+    // Keys in nlohmann's (sorted) order: action, branch / function / limit,
+    // node, value, variable
+    bool pretty = options.format == TraceFormat::Json;
+    auto key = [&](const char* name) {
+        sink->write(pretty ? ",\n        \"" : ",\"");
+        sink->write(name);
+        sink->write(pretty ? "\": " : "\":");
+    };
+    auto number = [&](auto n) {
+        char text[16];
+        auto end = std::to_chars(text, text + sizeof(text), n).ptr;
+        sink->write(std::string_view(text, static_cast<size_t>(end - text)));
+    };
+    const char* field = traceEventField(event.action);
+    auto payload = [&] {
+        key(field);
+        if (event.action == TraceAction::IfTaken)
+            sink->write(event.branch ? "\"then\"" : "\"else\"");
+        else
+            sink->writeJsonString(names[event.name]);
+    };
+    bool variable = field && traceEventHasValue(event.action);
+
+    if (pretty)
+        sink->write(inFile ? ",\n    {\n        \"action\": \"" : "\n    {\n        \"action\": \"");
+    else
+        sink->write("{\"action\":\"");
+    sink->write(traceActionName(event.action));
+    sink->put('"');
+    if (field && !variable)
+        payload();
+    if (event.node != kNoNode) {
+        key("node");
+        number(event.node);
+    }
+    if (options.values && traceEventHasValue(event.action)) {
+        key("value");
+        number(event.value);
+    }
+    if (variable)
+        payload();
+    sink->write(pretty ? "\n    }" : "}\n");
+
+    ++inFile;
+    ++events;
+}
+
+void TraceWriter::write(const TraceBuffer& buffer) {
+    if (options.fold) {
+        writeFolded(buffer);
+        return;
+    }
+    for (size_t i = 0; i < buffer.retained(); ++i)
+        write(buffer[i], buffer.names);
+}
+
+void TraceWriter::writeFolded(const TraceBuffer& buffer) {
+    BufferedSink out(outputPath(), options.atomic);
+    out.write(foldedTraceToJson(foldTrace(buffer, options.foldPeriod, options.values), buffer, options.values)
+                  .dump(4));
+    out.close();
+    failed = failed || !out.ok();
+    events += buffer.retained();
+    finished = true;
+}
+
+void TraceWriter::finish() {
+    if (finished)
+        return;
+    finished = true;
+    StringPool none;
+    if (options.format == TraceFormat::Columnar) {
+        failed = failed || !columns.write(outputPath(), names ? *names : none, options.values, options.atomic);
+        return;
+    }
+    if (!sink)
+        openFile();     // an empty trace still produces a (chunk) file
+    closeFile();
+
+    if (options.chunkEvents) {
+        json manifest;
+        manifest["format"] = options.format == TraceFormat::NdJson ? "ndjson" : "json";
+        manifest["events"] = events;
+        manifest["chunkEvents"] = options.chunkEvents;
+        manifest["chunks"] = json::array();
+        for (const auto& chunk : chunks) {
+            manifest["chunks"].push_back({{"file", chunk.file}, {"first", chunk.first},
+                                          {"count", chunk.count}, {"bytes", chunk.bytes}});
+        }
+        AsyncFile out(options.basePath + ".manifest.json", options.atomic);
+        out.write(manifest.dump(4));
+        failed = !out.close() || failed;
+    }
+    if (options.index) {
+        AsyncFile out(options.basePath + ".index.json", options.atomic);
+        out.write(index.toJson(names ? *names : none).dump());
+        failed = !out.close() || failed;
+    }
+}
+
+namespace {
+
+// Chunks are "<base>.<number>.json" or ".ndjson"; a new chunked run may
+// write fewer of them, so none are kept
+void removeTraceChunks(const std::string& basePath) {
+    namespace fs = std::filesystem;
+    std::error_code ignored;
+    fs::path base(basePath);
+    fs::path directory = base.has_parent_path() ? base.parent_path() : fs::path(".");
+    std::string prefix = base.filename().string() + ".";
+    std::vector<fs::path> chunkFiles;
+    for (fs::directory_iterator it(directory, ignored), end; !ignored && it != end; it.increment(ignored)) {
+        std::string name = it->path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) != 0)
+            continue;
+        size_t digits = prefix.size();
+        while (digits < name.size() && std::isdigit(static_cast<unsigned char>(name[digits])))
+            ++digits;
+        std::string extension = name.substr(digits);
+        if (digits - prefix.size() >= 4 && (extension == ".json" || extension == ".ndjson"))
+            chunkFiles.push_back(it->path());
+    }
+    for (const auto& file : chunkFiles)
+        fs::remove(file, ignored);
+}
+
+} // namespace
+
+void removeStaleTraceOutputs(const TraceWriterOptions& options) {
+    namespace fs = std::filesystem;
+    std::error_code ignored;
+    bool single = !options.chunkEvents;
+    if (!(single && options.format == TraceFormat::Json))
+        fs::remove(options.basePath + ".json", ignored);
+    if (!(single && options.format == TraceFormat::NdJson))
+        fs::remove(options.basePath + ".ndjson", ignored);
+    if (options.format != TraceFormat::Columnar)
+        fs::remove(options.basePath + ".columns", ignored);
+    if (single)
+        fs::remove(options.basePath + ".manifest.json", ignored);
+    if (!options.index)
+        fs::remove(options.basePath + ".index.json", ignored);
+    removeTraceChunks(options.basePath);
+}
+
+void removeTraceOutputs(const std::string& basePath) {
+    namespace fs = std::filesystem;
+    std::error_code ignored;
+    for (const char* extension : {".json", ".ndjson", ".columns", ".manifest.json", ".index.json", ".states.json"})
+        fs::remove(basePath + extension, ignored);
+    removeTraceChunks(basePath);
+}
@@ -0,0 +1,258 @@
+#include "TreeLayout.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <unordered_map>
+#include "AsyncFile.h"
+
+namespace {
+
+// Buchheim et al.'s first and second walks over the flattened tree. All
+// per-node state lives in arrays indexed by preorder position.
+class TidyTree {
+public:
+    TidyTree(TreeLayout& layout, const TreeLayoutOptions& options) : layout(layout), options(options) {}
+
+    void run(const Node& root) {
+        flatten(root, kNoNode, 0);
+        size_t n = layout.nodes.size();
+        prelim.assign(n, 0);
+        mod.assign(n, 0);
+        shift.assign(n, 0);
+        change.assign(n, 0);
+        thread.assign(n, kNoNode);
+        ancestor.resize(n);
+        for (size_t v = 0; v < n; ++v)
+            ancestor[v] = static_cast<uint32_t>(v);
+        layout.x.assign(n, 0);
+
+        firstWalk(0);
+        secondWalk(0, -prelim[0]);
+
+        double left = *std::min_element(layout.x.begin(), layout.x.end());
+        for (double& x : layout.x)
+            x -= left;
+        layout.width = *std::max_element(layout.x.begin(), layout.x.end());
+    }
+
+private:
+    TreeLayout& layout;
+    const TreeLayoutOptions& options;
+    std::vector<uint32_t> children;     // child lists: firstChild[v] .. + childCount[v]
+    std::vector<uint32_t> firstChild, childCount, number;   // number: index among siblings
+    std::vector<double> prelim, mod, shift, change;
+    std::vector<uint32_t> thread, ancestor;
+
+    void flatten(const Node& node, uint32_t parent, uint32_t depth) {
+        uint32_t v = static_cast<uint32_t>(layout.nodes.size());
+        layout.nodes.push_back(&node);
+        layout.parent.push_back(parent);
+        layout.depth.push_back(depth);
+        layout.height = std::max(layout.height, depth);
+        firstChild.push_back(kNoNode);
+        childCount.push_back(static_cast<uint32_t>(node.children.size()));
+        number.push_back(0);
+        // Children are not contiguous in preorder, so remember them in order
+        std::vector<uint32_t> kids;
+        kids.reserve(node.children.size());
+        for (size_t i = 0; i < node.children.size(); ++i) {
+            kids.push_back(static_cast<uint32_t>(layout.nodes.size()));
+            flatten(node.children[i], v, depth + 1);
+            number[kids.back()] = static_cast<uint32_t>(i);
+        }
+        if (!kids.empty())
+            firstChild[v] = static_cast<uint32_t>(children.size());
+        children.insert(children.end(), kids.begin(), kids.end());
+    }
+
+    uint32_t child(uint32_t v, uint32_t i) const { return children[firstChild[v] + i]; }
+    uint32_t leftmost(uint32_t v) const { return child(v, 0); }
+    uint32_t rightmost(uint32_t v) const { return child(v, childCount[v] - 1); }
+    bool leaf(uint32_t v) const { return childCount[v] == 0; }
+
+    uint32_t leftSibling(uint32_t v) const {
+        uint32_t p = layout.parent[v];
+        return p == kNoNode || number[v] == 0 ? kNoNode : child(p, number[v] - 1);
+    }
+
+    uint32_t leftmostSibling(uint32_t v) const {
+        uint32_t p = layout.parent[v];
+        return p == kNoNode ? v : leftmost(p);
+    }
+
+    uint32_t nextLeft(uint32_t v) const { return leaf(v) ? thread[v] : leftmost(v); }
+    uint32_t nextRight(uint32_t v) const { return leaf(v) ? thread[v] : rightmost(v); }
+
+    double separation(uint32_t a, uint32_t b) const {
+        return layout.parent[a] == layout.parent[b] ? options.siblingSeparation : options.cousinSeparation;
+    }
+
+    void firstWalk(uint32_t v) {
+        uint32_t w = leftSibling(v);
+        if (leaf(v)) {
+            prelim[v] = w == kNoNode ? 0 : prelim[w] + separation(w, v);
+            return;
+        }
+        uint32_t defaultAncestor = leftmost(v);
+        for (uint32_t i = 0; i < childCount[v]; ++i) {
+            uint32_t c = child(v, i);
+            firstWalk(c);
+            defaultAncestor = apportion(c, defaultAncestor);
+        }
+        executeShifts(v);
+        double midpoint = (prelim[leftmost(v)] + prelim[rightmost(v)]) / 2;
+        if (w != kNoNode) {
+            prelim[v] = prelim[w] + separation(w, v);
+            mod[v] = prelim[v] - midpoint;
+        }
+        else {
+            prelim[v] = midpoint;
+        }
+    }
+
+    // Pushes the subtree of v right until its left contour clears the right
+    // contours of its left siblings, threading contours as it goes.
+    uint32_t apportion(uint32_t v, uint32_t defaultAncestor) {
+        uint32_t w = leftSibling(v);
+        if (w == kNoNode)
+            return defaultAncestor;
+        uint32_t vip = v, vop = v, vim = w, vom = leftmostSibling(v);
+        double sip = mod[vip], sop = mod[vop], sim = mod[vim], som = mod[vom];
+        while (nextRight(vim) != kNoNode && nextLeft(vip) != kNoNode) {
+            vim = nextRight(vim);
+            vip = nextLeft(vip);
+            vom = nextLeft(vom);
+            vop = nextRight(vop);
+            ancestor[vop] = v;
+            double gap = (prelim[vim] + sim) - (prelim[vip] + sip) + separation(vim, vip);
+            if (gap > 0) {
+                uint32_t a = layout.parent[ancestor[vim]] == layout.parent[v] ? ancestor[vim] : defaultAncestor;
+                moveSubtree(a, v, gap);
+                sip += gap;
+                sop += gap;
+            }
+            sim += mod[vim];
+            sip += mod[vip];
+            som += mod[vom];
+            sop += mod[vop];
+        }
+        if (nextRight(vim) != kNoNode && nextRight(vop) == kNoNode) {
+            thread[vop] = nextRight(vim);
+            mod[vop] += sim - sop;
+        }
+        if (nextLeft(vip) != kNoNode && nextLeft(vom) == kNoNode) {
+            thread[vom] = nextLeft(vip);
+            mod[vom] += sip - som;
+            defaultAncestor = v;
+        }
+        return defaultAncestor;
+    }
+
+    // Shifts wp right by `amount` and spreads the shift over the siblings
+    // between wm and wp; executeShifts() applies the spread lazily.
+    void moveSubtree(uint32_t wm, uint32_t wp, double amount) {
+        double subtrees = number[wp] - number[wm];
+        change[wp] -= amount / subtrees;
+        shift[wp] += amount;
+        change[wm] += amount / subtrees;
+        prelim[wp] += amount;
+        mod[wp] += amount;
+    }
+
+    void executeShifts(uint32_t v) {
+        double total = 0, rate = 0;
+        for (uint32_t i = childCount[v]; i-- > 0;) {
+            uint32_t w = child(v, i);
+            prelim[w] += total;
+            mod[w] += total;
+            rate += change[w];
+            total += shift[w] + rate;
+        }
+    }
+
+    void secondWalk(uint32_t v, double m) {
+        layout.x[v] = prelim[v] + m;
+        for (uint32_t i = 0; i < childCount[v]; ++i)
+            secondWalk(child(v, i), m + mod[v]);
+    }
+};
+
+} // namespace
+
+TreeLayout layoutTree(const Node& root, const TreeLayoutOptions& options) {
+    TreeLayout layout;
+    TidyTree(layout, options).run(root);
+    return layout;
+}
+
+double layoutTileWidth(const TreeLayout& layout, const TreeLayoutOptions& options) {
+    if (options.tileWidth > 0)
+        return options.tileWidth;
+    // Spread the nodes of each band of tileDepth levels over columns
+    // holding about kLayoutTileNodes nodes each
+    double bands = layout.height / options.tileDepth + 1;
+    double columns = std::ceil(layout.nodes.size() / (kLayoutTileNodes * bands));
+    return std::max(32.0, std::ceil(layout.width / std::max(columns, 1.0)));
+}
+
+std::vector<LayoutTile> tileLayout(const TreeLayout& layout, const TreeLayoutOptions& options) {
+    double tileWidth = layoutTileWidth(layout, options);
+    std::unordered_map<uint64_t, size_t> index;
+    std::vector<LayoutTile> tiles;
+    for (uint32_t v = 0; v < layout.nodes.size(); ++v) {
+        uint32_t column = static_cast<uint32_t>(std::floor(layout.x[v] / tileWidth));
+        uint32_t row = layout.depth[v] / options.tileDepth;
+        uint64_t key = (static_cast<uint64_t>(row) << 32) | column;
+        auto inserted = index.emplace(key, tiles.size());
+        if (inserted.second)
+            tiles.push_back({column, row, {}});
+        tiles[inserted.first->second].nodes.push_back(v);
+    }
+    std::sort(tiles.begin(), tiles.end(), [](const LayoutTile& a, const LayoutTile& b) {
+        return a.row != b.row ? a.row < b.row : a.column < b.column;
+    });
+    return tiles;
+}
+
+bool writeTreeLayout(const TreeLayout& layout, const std::string& basePath, const TreeLayoutOptions& options) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::path directory = basePath + ".tiles";
+    fs::remove_all(directory, error);   // tiles of a previous run
+    fs::create_directories(directory, error);
+    if (error)
+        return false;
+
+    std::vector<LayoutTile> tiles = tileLayout(layout, options);
+    json manifest;
+    manifest["version"] = 1;
+    manifest["nodes"] = layout.nodes.size();
+    manifest["width"] = layout.width;
+    manifest["height"] = layout.height;
+    manifest["root"] = layout.x.empty() ? 0.0 : layout.x[0];
+    manifest["tileWidth"] = layoutTileWidth(layout, options);
+    manifest["tileDepth"] = options.tileDepth;
+    manifest["directory"] = directory.filename().string();
+    manifest["tiles"] = json::array();
+
+    bool ok = true;
+    for (const auto& tile : tiles) {
+        json nodes = json::array();
+        for (uint32_t v : tile.nodes) {
+            uint32_t p = layout.parent[v];
+            nodes.push_back({layout.nodes[v]->id, layout.x[v], layout.depth[v],
+                             p == kNoNode ? -1 : static_cast<int64_t>(layout.nodes[p]->id),
+                             p == kNoNode ? layout.x[v] : layout.x[p], layout.nodes[v]->children.size(),
+                             layout.nodes[v]->label});
+        }
+        std::string name = std::to_string(tile.column) + "_" + std::to_string(tile.row) + ".json";
+        AsyncFile out((directory / name).string(), options.atomic);
+        out.write(nodes.dump());
+        ok = out.close() && ok;
+        manifest["tiles"].push_back({tile.column, tile.row, tile.nodes.size()});
+    }
+
+    AsyncFile out(basePath + ".layout.json", options.atomic);
+    out.write(manifest.dump());
+    return out.close() && ok;
+}
@@ -0,0 +1,434 @@
+#include "TreeWriter.h"
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Collapsed subtree roots of one level-of-detail view -> hidden descendants
+using StubMap = std::unordered_map<const Node*, uint32_t>;
+
+template <typename Sink>
+class TreeEmitter {
+public:
+    TreeEmitter(Sink& sink, const TreeWriterOptions& options, const StubMap* stubs = nullptr)
+        : sink(sink), options(options), stubs(stubs) {}
+
+    void node(const Node& n, size_t depth) {
+        if (stubs) {
+            auto it = stubs->find(&n);
+            if (it != stubs->end()) {
+                stub(n, depth, it->second);
+                return;
+            }
+        }
+        begin(n, depth);
+        for (size_t i = 0; i < n.children.size(); ++i) {
+            separator(i, depth);
+            node(n.children[i], depth + 2);
+        }
+        end(n, depth);
+    }
+
+    // Keys follow nlohmann's sorted order: children, id, name, span.
+    // begin() opens the children array, end() closes it and writes the rest.
+    void begin(const Node& n, size_t depth) {
+        sink.put('{');
+        key("children", depth + 1, true);
+        sink.write(n.children.empty() ? "[]" : "[");
+    }
+
+    // Precedes the i-th child of a node at `depth`
+    void separator(size_t i, size_t depth) {
+        if (i)
+            sink.put(',');
+        newline(depth + 2);
+    }
+
+    // A node written with "children": [] and "collapsed": the number of
+    // descendants left out
+    void stub(const Node& n, size_t depth, uint32_t collapsed) {
+        sink.put('{');
+        key("children", depth + 1, true);
+        sink.write("[]");
+        key("collapsed", depth + 1);
+        number(collapsed);
+        end(n, depth, false);
+    }
+
+    // Children [from, to) of `n`, followed when more remain by a
+    // continuation stub: "collapsed" counts the nodes left out, "from" is
+    // the index of the first of them and "id" is the parent's
+    void page(const Node& n, size_t from, size_t to, uint32_t rest) {
+        begin(n, 0);
+        for (size_t i = from; i < to; ++i) {
+            separator(i - from, 0);
+            node(n.children[i], 2);
+        }
+        if (to < n.children.size()) {
+            separator(to - from, 0);
+            sink.put('{');
+            key("children", 3, true);
+            sink.write("[]");
+            key("collapsed", 3);
+            number(rest);
+            key("from", 3);
+            number(static_cast<uint32_t>(to));
+            key("id", 3);
+            number(n.id);
+            key("name", 3);
+            sink.write("\"...\"");
+            newline(2);
+            sink.put('}');
+        }
+        end(n, 0);
+    }
+
+    void end(const Node& n, size_t depth) { end(n, depth, !n.children.empty()); }
+
+    void end(const Node& n, size_t depth, bool openChildren) {
+        if (openChildren) {
+            newline(depth + 1);
+            sink.put(']');
+        }
+        key("id", depth + 1);
+        number(n.id);
+        key("name", depth + 1);
+        sink.writeJsonString(n.label);
+        if (options.spans) {
+            key("span", depth + 1);
+            sink.put('[');
+            newline(depth + 2);
+            number(n.offset);
+            sink.put(',');
+            newline(depth + 2);
+            number(n.length);
+            newline(depth + 1);
+            sink.put(']');
+        }
+        newline(depth);
+        sink.put('}');
+    }
+
+private:
+    Sink& sink;
+    const TreeWriterOptions& options;
+    const StubMap* stubs;
+
+    void newline(size_t depth) {
+        static const std::string spaces(256, ' ');
+        if (!options.pretty)
+            return;
+        sink.put('\n');
+        for (size_t n = depth * 4; n > 0;) {
+            size_t chunk = n < spaces.size() ? n : spaces.size();
+            sink.write(std::string_view(spaces.data(), chunk));
+            n -= chunk;
+        }
+    }
+
+    void key(const char* name, size_t depth, bool first = false) {
+        if (!first)
+            sink.put(',');
+        newline(depth);
+        sink.put('"');
+        sink.write(name);
+        sink.write(options.pretty ? "\": " : "\":");
+    }
+
+    void number(uint32_t value) {
+        char text[16];
+        auto end = std::to_chars(text, text + sizeof(text), value).ptr;
+        sink.write(std::string_view(text, static_cast<size_t>(end - text)));
+    }
+};
+
+constexpr size_t kBuffersPerThread = 2;
+
+// Serializes each top-level subtree (functions, includes, ...) into its own
+// buffer on a worker thread. Buffers are written in source order as soon as
+// they are ready, so the output is the same as the sequential walk.
+void writeTreeParallel(const Node& root, BufferedSink& sink, const TreeWriterOptions& options,
+                       unsigned threads) {
+    const size_t count = root.children.size();
+    std::vector<std::packaged_task<std::string()>> tasks;
+    std::vector<std::future<std::string>> results;
+    tasks.reserve(count);
+    results.reserve(count);
+    for (const auto& child : root.children) {
+        tasks.emplace_back([&child, &options] {
+            StringSink buffer;
+            TreeEmitter<StringSink>(buffer, options).node(child, 2);
+            return std::move(buffer.text);
+        });
+        results.push_back(tasks.back().get_future());
+    }
+
+    // Workers take subtrees in order, so the earliest buffers finish first.
+    // They stay at most kBuffersPerThread buffers per thread ahead of the
+    // writer, so memory does not grow with the tree.
+    const size_t window = kBuffersPerThread * static_cast<size_t>(threads);
+    std::mutex mutex;
+    std::condition_variable room;
+    size_t next = 0;
+    size_t written = 0;
+    std::vector<std::thread> workers;
+    // Joins the workers however this function exits: a subtree task that
+    // threw rethrows from get() below, and the workers still waiting for
+    // room must be told to stop first
+    struct Joiner {
+        std::vector<std::thread>& workers;
+        std::mutex& mutex;
+        std::condition_variable& room;
+        size_t& next;
+        size_t count;
+
+        ~Joiner() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                next = count;
+            }
+            room.notify_all();
+            for (auto& worker : workers)
+                worker.join();
+        }
+    } joiner{workers, mutex, room, next, count};
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (;;) {
+                size_t i;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    room.wait(lock, [&] { return next >= count || next < written + window; });
+                    if (next >= count)
+                        return;
+                    i = next++;
+                }
+                tasks[i]();
+            }
+        });
+    }
+
+    TreeEmitter<BufferedSink> emitter(sink, options);
+    emitter.begin(root, 0);
+    for (size_t i = 0; i < count; ++i) {
+        emitter.separator(i, 0);
+        sink.write(results[i].get());
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++written;
+        }
+        room.notify_all();
+    }
+    emitter.end(root, 0);
+}
+
+class DictionaryTable {
+public:
+    std::vector<std::string_view> entries;
+
+    uint32_t intern(std::string_view s) {
+        auto inserted = ids.emplace(s, static_cast<uint32_t>(entries.size()));
+        if (inserted.second)
+            entries.push_back(s);
+        return inserted.first->second;
+    }
+
+private:
+    std::unordered_map<std::string_view, uint32_t> ids;
+};
+
+void flattenLabels(const Node& n, DictionaryTable& prefixes, DictionaryTable& strings,
+                   std::vector<uint32_t>& nodes) {
+    std::string_view label = n.label;
+    size_t split = label.find(": ");
+    split = split == std::string_view::npos ? 0 : split + 2;
+    nodes.push_back(prefixes.intern(label.substr(0, split)));
+    nodes.push_back(strings.intern(label.substr(split)));
+    nodes.push_back(static_cast<uint32_t>(n.children.size()));
+    for (const auto& child : n.children)
+        flattenLabels(child, prefixes, strings, nodes);
+}
+
+void flattenSpans(const Node& n, std::vector<uint32_t>& spans) {
+    spans.push_back(n.offset);
+    spans.push_back(n.length);
+    for (const auto& child : n.children)
+        flattenSpans(child, spans);
+}
+
+void writeDictionaryTree(const Node& root, BufferedSink& sink, bool spans) {
+    DictionaryTable prefixes, strings;
+    std::vector<uint32_t> nodes;
+    flattenLabels(root, prefixes, strings, nodes);
+
+    auto numbers = [&](const char* key, const std::vector<uint32_t>& values) {
+        sink.write(key);
+        sink.put('[');
+        char text[16];
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (i)
+                sink.put(',');
+            auto end = std::to_chars(text, text + sizeof(text), values[i]).ptr;
+            sink.write(std::string_view(text, static_cast<size_t>(end - text)));
+        }
+        sink.put(']');
+    };
+    auto table = [&](const char* key, const DictionaryTable& entries) {
+        sink.write(key);
+        sink.put('[');
+        for (size_t i = 0; i < entries.entries.size(); ++i) {
+            if (i)
+                sink.put(',');
+            sink.writeJsonString(entries.entries[i]);
+        }
+        sink.put(']');
+    };
+
+    // Keys in sorted order, like the nested schema
+    numbers("{\"nodes\":", nodes);
+    table(",\"prefixes\":", prefixes);
+    if (spans) {
+        std::vector<uint32_t> ranges;
+        flattenSpans(root, ranges);
+        numbers(",\"spans\":", ranges);
+    }
+    table(",\"strings\":", strings);
+    sink.write(",\"version\":");
+    sink.write(std::to_string(kTreeDictionaryVersion));
+    sink.put('}');
+}
+
+} // namespace
+
+void writeTree(const Node& root, BufferedSink& sink, const TreeWriterOptions& options) {
+    if (options.schema == TreeSchema::Dictionary) {
+        writeDictionaryTree(root, sink, options.spans);
+        return;
+    }
+    unsigned threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+    if (threads > root.children.size())
+        threads = static_cast<unsigned>(root.children.size());
+    if (threads > 1)
+        writeTreeParallel(root, sink, options, threads);
+    else
+        TreeEmitter<BufferedSink>(sink, options).node(root, 0);
+}
+
+bool writeTreeFile(const Node& root, const std::string& path, const TreeWriterOptions& options) {
+    BufferedSink sink(path);
+    writeTree(root, sink, options);
+    sink.close();
+    return sink.ok();
+}
+
+namespace {
+
+uint32_t countSubtrees(const Node& n, std::unordered_map<const Node*, uint32_t>& sizes) {
+    uint32_t size = 1;
+    for (const auto& child : n.children)
+        size += countSubtrees(child, sizes);
+    sizes.emplace(&n, size);
+    return size;
+}
+
+// One file of the level-of-detail export: children [from, to) of `top`
+// (the rest, if any, behind a continuation stub) and the stubs below them
+struct LevelView {
+    size_t to;
+    uint32_t rest = 0;      // nodes in the subtrees of children [to, end)
+    StubMap stubs;
+};
+
+// Picks the nodes of the view rooted at `top` breadth first: a node's
+// children are shown together or not at all, while they stay within
+// detailDepth levels and the view within detailNodes nodes. The children
+// of `top` itself are always shown, a page of them at a time when there
+// are more than the budget, so every part makes progress and stays small.
+LevelView collapseView(const Node& top, size_t from, const TreeWriterOptions& options,
+                       const std::unordered_map<const Node*, uint32_t>& sizes) {
+    LevelView view;
+    size_t count = top.children.size() - from;
+    size_t room = options.detailNodes ? options.detailNodes - 1 : count;
+    if (count > room)
+        --room;     // keep a place for the continuation stub
+    view.to = from + std::min(count, room);
+    for (size_t i = view.to; i < top.children.size(); ++i)
+        view.rest += sizes.at(&top.children[i]);
+
+    std::deque<std::pair<const Node*, uint32_t>> queue;
+    size_t shown = 1 + (view.to - from) + (view.rest ? 1 : 0);
+    for (size_t i = from; i < view.to; ++i)
+        queue.emplace_back(&top.children[i], 1);
+    while (!queue.empty()) {
+        auto [n, level] = queue.front();
+        queue.pop_front();
+        if (n->children.empty())
+            continue;
+        bool fits = (!options.detailDepth || level < options.detailDepth) &&
+                    (!options.detailNodes || shown + n->children.size() <= options.detailNodes);
+        if (!fits) {
+            view.stubs.emplace(n, sizes.at(n) - 1);
+            continue;
+        }
+        shown += n->children.size();
+        for (const auto& child : n->children)
+            queue.emplace_back(&child, level + 1);
+    }
+    return view;
+}
+
+} // namespace
+
+bool writeTreeLevels(const Node& root, const std::string& path, const std::string& partsDirectory,
+                     const TreeWriterOptions& options) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::remove_all(partsDirectory, error);  // parts of a previous run
+    fs::create_directories(partsDirectory, error);
+    if (error)
+        return false;
+
+    std::unordered_map<const Node*, uint32_t> sizes;
+    countSubtrees(root, sizes);
+
+    // Every stub of a view becomes the top of its own part file, and a
+    // continuation the next page of its parent's children
+    bool ok = true;
+    std::deque<std::pair<const Node*, size_t>> pending{{&root, 0}};
+    while (!pending.empty()) {
+        auto [top, from] = pending.front();
+        pending.pop_front();
+        LevelView view = collapseView(*top, from, options, sizes);
+        std::string file = path;
+        bool part = top != &root || from;
+        if (part) {
+            std::string name = std::to_string(top->id);
+            if (from)
+                name += "-" + std::to_string(from);
+            file = (fs::path(partsDirectory) / (name + ".json")).string();
+        }
+        // The caller stages `path` itself
+        BufferedSink sink(file, part && options.atomicParts);
+        TreeEmitter<BufferedSink> emitter(sink, options, &view.stubs);
+        if (top->children.empty())
+            emitter.node(*top, 0);
+        else
+            emitter.page(*top, from, view.to, view.rest);
+        sink.close();
+        ok = ok && sink.ok();
+        for (const auto& stub : view.stubs)
+            pending.emplace_back(stub.first, 0);
+        if (view.to < top->children.size())
+            pending.emplace_back(top, view.to);
+    }
+    return ok;
+}
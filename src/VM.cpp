@@ -0,0 +1,269 @@
+#include "VM.h"
+#include "TraceGenerator.h"
+#include <algorithm>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_COMPUTED_GOTO 1
+#else
+#define VM_COMPUTED_GOTO 0
+#endif
+
+namespace {
+
+// The deadline is only polled this often, keeping the per-instruction
+// budget check to a single compare.
+constexpr uint64_t kClockInterval = 4096;
+
+uint32_t actionBit(TraceAction action) {
+    return 1u << static_cast<uint32_t>(action);
+}
+
+uint32_t granularityMask(TraceGranularity granularity) {
+    if (granularity == TraceGranularity::Function)
+        return actionBit(TraceAction::Call) | actionBit(TraceAction::Return);
+    return ~0u;
+}
+
+} // namespace
+
+const char* executionStatusName(ExecutionStatus status) {
+    switch (status) {
+    case ExecutionStatus::Completed: return "completed";
+    case ExecutionStatus::StepLimit: return "steps";
+    case ExecutionStatus::CallDepthLimit: return "call_depth";
+    case ExecutionStatus::TraceEventLimit: return "trace_events";
+    case ExecutionStatus::TimeLimit: return "time";
+    }
+    return "";
+}
+
+// `steps` already counts the instruction about to run, so exactly
+// maxSteps instructions run before the limit stops the VM.
+bool VM::checkBudget() {
+    if (budget.maxSteps && steps > budget.maxSteps) {
+        status = ExecutionStatus::StepLimit;
+        return false;
+    }
+    if (budget.timeLimitMs && std::chrono::steady_clock::now() >= deadline) {
+        status = ExecutionStatus::TimeLimit;
+        return false;
+    }
+    nextCheck = steps + kClockInterval;
+    if (budget.maxSteps && nextCheck > budget.maxSteps + 1)
+        nextCheck = budget.maxSteps + 1;
+    return true;
+}
+
+void VM::recordTrace(const Instruction& ins) {
+    if (states)
+        states->event(trace.size());
+    // Variable events directly follow the Store they describe
+    TraceAction action = static_cast<TraceAction>(ins.flag);
+    int value = traceEventHasValue(action) ? lastStored : 0;
+    trace.push({action, static_cast<uint8_t>(ins.b), 0, traceNames[ins.a], ins.node, value, steps});
+}
+
+void VM::pushFrame(uint32_t function, uint32_t returnIp) {
+    uint32_t count = program.functions[function].slotCount();
+    if (slotValues.size() < slotTop + count) {
+        slotValues.resize((slotTop + count) * 2);
+        slotDefined.resize((slotTop + count) * 2);
+    }
+    std::fill_n(slotDefined.begin() + slotTop, count, 0);
+    frames.push_back({function, returnIp, slotTop});
+    slotTop += count;
+}
+
+ExecutionStatus VM::run(uint32_t function, VariableStore& vars) {
+    const Instruction* code = program.code.data();
+    status = ExecutionStatus::Completed;
+    steps = 0;
+    nextCheck = 0;
+    traceLimit = budget.maxTraceEvents ? trace.size() + budget.maxTraceEvents : 0;
+    traceMask = granularityMask(policy.granularity);
+    sampleSkip = 0;
+    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budget.timeLimitMs);
+    traceNames.resize(program.names.size());
+    for (size_t id = 0; id < program.names.size(); ++id)
+        traceNames[id] = trace.names.intern(program.names[id]);
+    stack.clear();
+    loopCounters.clear();
+    frames.clear();
+    slotTop = 0;
+
+    pushFrame(function, 0);
+    vars.resize(program.functions[function].slotCount());
+    std::copy(vars.values.begin(), vars.values.end(), slotValues.begin());
+    std::copy(vars.defined.begin(), vars.defined.end(), slotDefined.begin());
+    int* values = slotValues.data();
+    uint8_t* defined = slotDefined.data();
+    if (states) {
+        states->call(function);
+        for (uint32_t slot = 0; slot < vars.values.size(); ++slot) {
+            if (defined[slot])
+                states->set(0, slot, values[slot]);
+        }
+    }
+
+    uint32_t ip = program.functions[function].entry;
+    const Instruction* ins = nullptr;
+
+#define VM_BINARY(expr)                 \
+    {                                   \
+        int right = stack.back();       \
+        stack.pop_back();               \
+        int left = stack.back();        \
+        stack.back() = (expr);          \
+    }
+
+#if VM_COMPUTED_GOTO
+    static const void* dispatch[] = {
+#define BYTECODE_LABEL(name) &&op_##name,
+        BYTECODE_OPS(BYTECODE_LABEL)
+#undef BYTECODE_LABEL
+    };
+#define VM_CASE(name) op_##name:
+#define VM_NEXT()                                           \
+    do {                                                    \
+        if (++steps >= nextCheck && !checkBudget())         \
+            goto stopped;                                   \
+        ins = &code[ip++];                                  \
+        goto *dispatch[static_cast<int>(ins->op)];          \
+    } while (0)
+    VM_NEXT();
+#else
+#define VM_CASE(name) case OpCode::name:
+#define VM_NEXT() continue
+    for (;;) {
+        if (++steps >= nextCheck && !checkBudget())
+            goto stopped;
+        ins = &code[ip++];
+        switch (ins->op) {
+#endif
+
+    VM_CASE(PushConst)
+        stack.push_back(static_cast<int>(ins->a));
+        VM_NEXT();
+    VM_CASE(Load)
+        stack.push_back(defined[ins->a] ? values[ins->a] : 0);
+        VM_NEXT();
+    VM_CASE(Store)
+        values[ins->a] = lastStored = stack.back();
+        defined[ins->a] = 1;
+        if (states)
+            states->set(static_cast<uint32_t>(frames.size() - 1), ins->a, values[ins->a]);
+        stack.pop_back();
+        VM_NEXT();
+    VM_CASE(Pop)
+        stack.pop_back();
+        VM_NEXT();
+    VM_CASE(Add) VM_BINARY(left + right) VM_NEXT();
+    VM_CASE(Sub) VM_BINARY(left - right) VM_NEXT();
+    VM_CASE(Mul) VM_BINARY(left * right) VM_NEXT();
+    VM_CASE(Div) VM_BINARY(right != 0 ? left / right : 0) VM_NEXT();
+    VM_CASE(Mod) VM_BINARY(right != 0 ? left % right : 0) VM_NEXT();
+    VM_CASE(Eq) VM_BINARY(left == right) VM_NEXT();
+    VM_CASE(Ne) VM_BINARY(left != right) VM_NEXT();
+    VM_CASE(Lt) VM_BINARY(left < right) VM_NEXT();
+    VM_CASE(Gt) VM_BINARY(left > right) VM_NEXT();
+    VM_CASE(Le) VM_BINARY(left <= right) VM_NEXT();
+    VM_CASE(Ge) VM_BINARY(left >= right) VM_NEXT();
+    VM_CASE(Jump)
+        ip = ins->a;
+        VM_NEXT();
+    VM_CASE(JumpIfFalse)
+        if (!stack.back())
+            ip = ins->a;
+        stack.pop_back();
+        VM_NEXT();
+    VM_CASE(LoopEnter)
+        loopCounters.push_back(0);
+        VM_NEXT();
+    VM_CASE(LoopCheck)
+        if (budget.maxLoopIterations && loopCounters.back() >= budget.maxLoopIterations)
+            ip = ins->a;
+        VM_NEXT();
+    VM_CASE(LoopNext)
+        ++loopCounters.back();
+        VM_NEXT();
+    VM_CASE(LoopExit)
+        loopCounters.pop_back();
+        VM_NEXT();
+    VM_CASE(CinDefault)
+        if (!defined[ins->a]) {
+            values[ins->a] = 5;
+            defined[ins->a] = 1;
+            if (states)
+                states->set(static_cast<uint32_t>(frames.size() - 1), ins->a, 5);
+        }
+        VM_NEXT();
+    VM_CASE(Call) {
+        if (budget.maxCallDepth && frames.size() >= budget.maxCallDepth) {
+            status = ExecutionStatus::CallDepthLimit;
+            goto stopped;
+        }
+        const BytecodeFunction& callee = program.functions[ins->a];
+        pushFrame(ins->a, ip);
+        values = slotValues.data() + frames.back().base;
+        defined = slotDefined.data() + frames.back().base;
+        uint32_t argc = ins->b;
+        const int* args = stack.data() + stack.size() - argc;
+        if (states)
+            states->call(ins->a);
+        for (uint32_t i = 0; i < argc && i < callee.paramCount; ++i) {
+            values[i] = args[i];
+            defined[i] = 1;
+            if (states)
+                states->set(static_cast<uint32_t>(frames.size() - 1), i, args[i]);
+        }
+        stack.resize(stack.size() - argc);
+        ip = callee.entry;
+        VM_NEXT();
+    }
+    VM_CASE(Ret) {
+        if (states)
+            states->ret();
+        ip = frames.back().returnIp;
+        slotTop = frames.back().base;
+        frames.pop_back();
+        values = slotValues.data() + frames.back().base;
+        defined = slotDefined.data() + frames.back().base;
+        VM_NEXT();
+    }
+    VM_CASE(Trace)
+        if (!((traceMask >> ins->flag) & 1))
+            VM_NEXT();
+        if (sampleSkip) {
+            --sampleSkip;
+            VM_NEXT();
+        }
+        if (policy.sampleEvery > 1)
+            sampleSkip = policy.sampleEvery - 1;
+        if (traceLimit && trace.size() >= traceLimit) {
+            status = ExecutionStatus::TraceEventLimit;
+            goto stopped;
+        }
+        recordTrace(*ins);
+        VM_NEXT();
+    VM_CASE(Halt)
+        goto finished;
+
+#if !VM_COMPUTED_GOTO
+        }
+    }
+#endif
+
+stopped:
+    if (states)
+        states->event(trace.size());
+    trace.push({TraceAction::BudgetExhausted, 0, 0, trace.names.intern(executionStatusName(status)), kNoNode, 0,
+                steps});
+finished:
+    std::copy_n(slotValues.begin(), vars.values.size(), vars.values.begin());
+    std::copy_n(slotDefined.begin(), vars.defined.size(), vars.defined.begin());
+    return status;
+
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_BINARY
+}
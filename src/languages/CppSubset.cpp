@@ -0,0 +1,326 @@
+#include "languages/CppSubset.h"
+#include <iterator>
+#include "Grammar.h"
+#include "Parser.h"
+#include "SymbolTable.h"
+
+// Semantic actions of the grammar in CppSubset.h. Each gets the values of
+// its alternative's symbols in order (mid-rule actions aside) and builds the
+// same nodes, spans and symbol-table rows the hand-written parser did.
+
+namespace {
+
+using Context = ActionContext;
+
+template <typename... Children>
+Node makeNode(std::string label, Children&&... children) {
+    Node node = {std::move(label)};
+    node.children.reserve(sizeof...(children));
+    (node.children.push_back(std::move(children)), ...);
+    return node;
+}
+
+// Repetitions are collected last first
+void appendInOrder(Node& node, std::vector<Node>& list) {
+    node.children.insert(node.children.end(), std::make_move_iterator(list.rbegin()),
+                         std::make_move_iterator(list.rend()));
+}
+
+Node listNode(const Context& context, std::string label, std::vector<Node>& list) {
+    Node node = {std::move(label)};
+    appendInOrder(node, list);
+    return context.finish(std::move(node));
+}
+
+Node varLeaf(const Token& name) {
+    return Context::leaf("Var: " + name.value, name);
+}
+
+// The value of an expression that is an integer literal, for the symbol table
+bool constantValue(const Node& expr, int& value) {
+    return !expr.children.empty() && expr.children[0].label.substr(0, 7) == "Value: " &&
+           parseIntLiteral(std::string_view(expr.children[0].label).substr(7), value);
+}
+
+// `name` alone, or called with `arguments`
+Node primary(const Token& name, Node arguments) {
+    if (arguments.label.empty())
+        return Context::span(makeNode("Expr", Context::leaf("Value: " + name.value, name)), name, name);
+    Node call = makeNode("FunctionCall", Context::leaf("Callee: " + name.value, name), std::move(arguments));
+    call.offset = name.offset;
+    call.length = call.children[1].offset + call.children[1].length - name.offset;
+    return call;
+}
+
+// Folds `left` and the operator / operand pairs of `tail` (last first) to
+// the left, each Expr spanning from the first operand
+Node foldBinary(Node left, std::vector<Node>& tail) {
+    uint32_t start = left.offset;
+    while (tail.size() >= 2) {
+        Node op = std::move(tail.back());
+        tail.pop_back();
+        Node right = std::move(tail.back());
+        tail.pop_back();
+        uint32_t end = right.offset + right.length;
+        left = makeNode("Expr", std::move(left), std::move(op), std::move(right));
+        left.offset = start;
+        left.length = end - start;
+    }
+    return left;
+}
+
+void program(Context& context, ParseValue* rhs, ParseValue& out) {
+    out.node = listNode(context, "Program", rhs[0].list);
+}
+
+void prepend(Context&, ParseValue* rhs, ParseValue& out) {
+    out.list = std::move(rhs[1].list);
+    out.list.push_back(std::move(rhs[0].node));
+}
+
+void prependSecond(Context&, ParseValue* rhs, ParseValue& out) {
+    out.list = std::move(rhs[2].list);
+    out.list.push_back(std::move(rhs[1].node));
+}
+
+void prependVar(Context&, ParseValue* rhs, ParseValue& out) {
+    out.list = std::move(rhs[2].list);
+    out.list.push_back(varLeaf(*rhs[1].token));
+}
+
+void second(Context&, ParseValue* rhs, ParseValue& out) {
+    out = std::move(rhs[1]);
+}
+
+void include(Context&, ParseValue* rhs, ParseValue& out) {
+    out.node = Context::leaf("Include: " + rhs[0].token->value, *rhs[0].token);
+}
+
+void usingNamespace(Context& context, ParseValue* rhs, ParseValue& out) {
+    out.node = context.finish({"Using: namespace " + rhs[2].token->value});
+}
+
+void enterScope(Context& context, ParseValue* rhs, ParseValue&) {
+    context.scope = rhs[1].token->value;
+}
+
+void function(Context& context, ParseValue* rhs, ParseValue& out) {
+    out.node = context.finish(makeNode("Function",
+                                       Context::leaf("ReturnType: " + rhs[0].token->value, *rhs[0].token),
+                                       Context::leaf("FunctionName: " + rhs[1].token->value, *rhs[1].token),
+                                       std::move(rhs[2].node), std::move(rhs[3].node)));
+    context.scope = "global";
+}
+
+void parameters(Context& context, ParseValue* rhs, ParseValue& out) {
+    out.node = listNode(context, "Parameters", rhs[1].list);
+}
+
+void parameter(Context& context, ParseValue* rhs, ParseValue& out) {
+    out.node = context.finish({rhs[0].token->value + " " + rhs[1].token->value});
+}
+
+void body(Context& context, ParseValue* rhs, ParseValue& out) {
+    out.node = listNode(context, "Body", rhs[1].list);
+}
+
+void block(Context& context, ParseValue* rhs, ParseValue& out) {
+    out.node = listNode(context, "Block", rhs[1].list);
+}
+
+void declaration(Context& context, ParseValue* rhs, ParseValue& out) {
+    const Token& type = *rhs[0].token;
+    const Token& name = *rhs[1].token;
+    Node decl = makeNode("VarDecl", Context::span({type.value + " " + name.value}, type, name));
+    SymbolEntry entry = {name.value, type.value, context.scope, 0, false};
+    if (!rhs[2].node.label.empty()) {
+        entry.hasValue = constantValue(rhs[2].node, entry.value);
+        decl.children.push_back(std::move(rhs[2].node));
+    }
+    symbolTable.push_back(std::move(entry));
+    out.node = context.finish(std::move(decl));
+}
+
+void returnStatement(Context& context, ParseValue* rhs, ParseValue& out) {
+    out.node = context.finish(makeNode("Return", std::move(rhs[1].node)));
+}
+
+void ifStatement(Context& context, ParseValue* rhs, ParseValue& out) {
+    Node node = makeNode("If", std::move(rhs[2].node), std::move(rhs[4].node));
+    if (!rhs[5].node.label.empty())
+        node.children.push_back(std::move(rhs[5].node));
+    out.node = context.finish(std::move(node));
+}
+
+void whileStatement(Context& context, ParseValue* rhs, ParseValue& out) {
+    out.node = context.finish(makeNode("While", std::move(rhs[2].node), std::move(rhs[4].node)));
+}
+
+// for ( init cond ; update ) body, the init left out when it is just ';'
+void forStatement(Context& context, ParseValue* rhs, ParseValue& out) {
+    Node node = {"For"};
+    if (!rhs[2].node.label.empty())
+        node.children.push_back(std::move(rhs[2].node));
+    node.children.push_back(std::move(rhs[3].node));
+    node.children.push_back(std::move(rhs[5].node));
+    node.children.push_back(std::move(rhs[7].node));
+    out.node = context.finish(std::move(node));
+}
+
+void alwaysTrue(Context&, ParseValue*, ParseValue& out) {
+    out.node = {"Expr", {{"Value: 1"}}};
+}
+
+void noUpdate(Context&, ParseValue*, ParseValue& out) {
+    out.node = {"Expr", {{"Value: 0"}}};
+}
+
+void coutStatement(Context& context, ParseValue* rhs, ParseValue& out) {
+    Node node = makeNode("Cout", std::move(rhs[2].node));
+    appendInOrder(node, rhs[3].list);
+    out.node = context.finish(std::move(node));
+}
+
+void cinStatement(Context& context, ParseValue* rhs, ParseValue& out) {
+    Node node = makeNode("Cin", varLeaf(*rhs[2].token));
+    appendInOrder(node, rhs[3].list);
+    out.node = context.finish(std::move(node));
+}
+
+// The tails after a statement's (or for update's) identifier build their
+// node without it; identStatement / identUpdate put it in front
+void assignTail(Context&, ParseValue* rhs, ParseValue& out) {
+    out.node = makeNode("Assignment", std::move(rhs[1].node));
+}
+
+void callTail(Context&, ParseValue* rhs, ParseValue& out) {
+    out.node = makeNode("FunctionCall", std::move(rhs[0].node));
+}
+
+void stepTail(Context&, ParseValue* rhs, ParseValue& out) {
+    out.node = {rhs[0].token->value == "++" ? "Increment" : "Decrement"};
+}
+
+// An update that is an expression: its call arguments, if any, after the
+// operator / operand pairs
+void exprTail(Context&, ParseValue* rhs, ParseValue& out) {
+    out.list = std::move(rhs[1].list);
+    out.list.push_back(std::move(rhs[0].node));
+}
+
+void identStatement(Context& context, ParseValue* rhs, ParseValue& out) {
+    const Token& name = *rhs[0].token;
+    Node node = std::move(rhs[1].node);
+    bool call = node.label == "FunctionCall";
+    node.children.insert(node.children.begin(),
+                         call ? Context::leaf("Callee: " + name.value, name) : varLeaf(name));
+    int value;
+    if (node.label == "Assignment" && constantValue(node.children[1], value)) {
+        for (auto& entry : symbolTable) {
+            if (entry.name == name.value && entry.scope == context.scope) {
+                entry.value = value;
+                entry.hasValue = true;
+                break;
+            }
+        }
+    }
+    out.node = context.finish(std::move(node));
+}
+
+void identUpdate(Context& context, ParseValue* rhs, ParseValue& out) {
+    const Token& name = *rhs[0].token;
+    Node node = std::move(rhs[1].node);
+    if (node.label.empty()) {
+        std::vector<Node>& tail = rhs[1].list;
+        Node arguments = std::move(tail.back());
+        tail.pop_back();
+        out.node = foldBinary(primary(name, std::move(arguments)), tail);
+        return;
+    }
+    node.children.insert(node.children.begin(), varLeaf(name));
+    out.node = context.finish(std::move(node));
+}
+
+void prefixStep(Context& context, ParseValue* rhs, ParseValue& out) {
+    out.node = context.finish(makeNode(rhs[0].token->value == "++" ? "Increment" : "Decrement",
+                                       varLeaf(*rhs[1].token)));
+}
+
+// ++i, or an expression whose first operand is the operator itself
+void prefixUpdate(Context& context, ParseValue* rhs, ParseValue& out) {
+    if (rhs[1].token) {
+        prefixStep(context, rhs, out);
+        return;
+    }
+    Node op = context.span(makeNode("Expr", Context::leaf("Value: " + rhs[0].token->value, *rhs[0].token)),
+                           *rhs[0].token, *rhs[0].token);
+    out.node = foldBinary(std::move(op), rhs[1].list);
+}
+
+void expression(Context&, ParseValue* rhs, ParseValue& out) {
+    out.node = foldBinary(std::move(rhs[0].node), rhs[1].list);
+}
+
+void binaryTail(Context&, ParseValue* rhs, ParseValue& out) {
+    out.list = std::move(rhs[2].list);
+    out.list.push_back(std::move(rhs[1].node));
+    out.list.push_back(Context::leaf("Op: " + rhs[0].token->value, *rhs[0].token));
+}
+
+void identPrimary(Context&, ParseValue* rhs, ParseValue& out) {
+    out.node = primary(*rhs[0].token, std::move(rhs[1].node));
+}
+
+void value(Context& context, ParseValue* rhs, ParseValue& out) {
+    out.node = context.finish(makeNode("Expr", Context::leaf("Value: " + rhs[0].token->value, *rhs[0].token)));
+}
+
+void arguments(Context& context, ParseValue* rhs, ParseValue& out) {
+    out.node = listNode(context, "Arguments", rhs[1].list);
+}
+
+constexpr NamedAction actions[] = {
+    {"program", program},
+    {"prepend", prepend},
+    {"prependSecond", prependSecond},
+    {"prependVar", prependVar},
+    {"second", second},
+    {"include", include},
+    {"usingNamespace", usingNamespace},
+    {"enterScope", enterScope},
+    {"function", function},
+    {"parameters", parameters},
+    {"parameter", parameter},
+    {"body", body},
+    {"block", block},
+    {"declaration", declaration},
+    {"returnStatement", returnStatement},
+    {"ifStatement", ifStatement},
+    {"whileStatement", whileStatement},
+    {"forStatement", forStatement},
+    {"alwaysTrue", alwaysTrue},
+    {"noUpdate", noUpdate},
+    {"coutStatement", coutStatement},
+    {"cinStatement", cinStatement},
+    {"assignTail", assignTail},
+    {"callTail", callTail},
+    {"stepTail", stepTail},
+    {"exprTail", exprTail},
+    {"identStatement", identStatement},
+    {"identUpdate", identUpdate},
+    {"prefixStep", prefixStep},
+    {"prefixUpdate", prefixUpdate},
+    {"expression", expression},
+    {"binaryTail", binaryTail},
+    {"identPrimary", identPrimary},
+    {"value", value},
+    {"arguments", arguments},
+};
+
+} // namespace
+
+// A grammar error (a conflict, an unknown action) fails the build here
+constexpr Grammar cpp_subset::grammarTables =
+    buildGrammar(cpp_subset::grammar, actions, {cpp_subset::keywords, std::size(cpp_subset::keywords)},
+                 {cpp_subset::typeNames, std::size(cpp_subset::typeNames)},
+                 {cpp_subset::binaryOperators, std::size(cpp_subset::binaryOperators)});
@@ -0,0 +1,64 @@
+// openArtifactBundle rejects trace events whose action or name the
+// readers could not use, rather than leaving them to index out of bounds.
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include "ArtifactBundle.h"
+
+namespace {
+
+int failures = 0;
+const std::string path = "artifact_bundle_test.bundle";
+
+std::vector<char> writeBundle() {
+    Node tree{"Program", {{"Function"}}};
+    TraceBuffer trace;
+    uint32_t main = trace.names.intern("main");
+    trace.push({TraceAction::Call, 0, 0, main, 1, 0, 1});
+    trace.push({TraceAction::IfEnter, 0, 0, kNoName, 1, 0, 2});
+    trace.push({TraceAction::IfTaken, 1, 0, kNoName, 1, 0, 3});
+    trace.push({TraceAction::Return, 0, 0, main, 1, 0, 4});
+    writeArtifactBundle(path, tree, trace, {}, 0);
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), {});
+}
+
+// Copy of the bundle bytes with event `i` changed by `edit`
+template <typename Edit>
+void expect(const char* name, std::vector<char> bytes, size_t i, Edit edit, bool valid) {
+    BundleHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    for (uint32_t s = 0; s < header.sectionCount; ++s) {
+        BundleSection section;
+        std::memcpy(&section, bytes.data() + sizeof(header) + s * sizeof(section), sizeof(section));
+        if (section.kind != BundleSectionKind::Events)
+            continue;
+        TraceEvent event;
+        char* at = bytes.data() + section.offset + i * sizeof(TraceEvent);
+        std::memcpy(&event, at, sizeof(event));
+        edit(event);
+        std::memcpy(at, &event, sizeof(event));
+    }
+    std::ofstream(path, std::ios::binary).write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    if (openArtifactBundle(path).ok() == valid)
+        return;
+    ++failures;
+    std::cerr << name << ": expected the bundle to be " << (valid ? "accepted" : "rejected") << "\n";
+}
+
+} // namespace
+
+int main() {
+    std::vector<char> bytes = writeBundle();
+    expect("unchanged", bytes, 0, [](TraceEvent&) {}, true);
+    expect("unknown action", bytes, 1, [](TraceEvent& e) { e.action = static_cast<TraceAction>(200); }, false);
+    expect("action past the last", bytes, 1,
+           [](TraceEvent& e) { e.action = static_cast<TraceAction>(kTraceActionCount); }, false);
+    expect("call without a name", bytes, 0, [](TraceEvent& e) { e.name = kNoName; }, false);
+    expect("return naming no string", bytes, 3, [](TraceEvent& e) { e.name = 7; }, false);
+    expect("if without a name", bytes, 1, [](TraceEvent& e) { e.name = kNoName; }, true);
+    std::filesystem::remove(path);
+    return failures ? 1 : 0;
+}
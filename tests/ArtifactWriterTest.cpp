@@ -0,0 +1,140 @@
+// Output files come out byte-identical whether AsyncFile queues them to
+// io_uring or writes them with pwrite(), and write errors are reported on
+// both paths; atomic files replace their target only when complete. The
+// io_uring half only runs where the kernel allows a ring.
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "ArtifactWriter.h"
+#include "AsyncFile.h"
+#include "BufferedSink.h"
+
+namespace {
+
+int failures = 0;
+const std::string dir = "artifact_writer_test";
+
+void check(bool condition, const std::string& what) {
+    if (condition)
+        return;
+    ++failures;
+    std::cerr << what << "\n";
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+// Several MB of small pieces, with a piece larger than the sink's buffer
+// now and then
+std::string writeSink(BufferedSink& sink) {
+    std::string expected;
+    for (int i = 0; i < 200000; ++i) {
+        std::string piece = "{\"event\":" + std::to_string(i) + "}\n";
+        if (i % 50000 == 0)
+            piece.append(100000, static_cast<char>('a' + i % 26));
+        sink.write(piece);
+        expected += piece;
+    }
+    return expected;
+}
+
+void testBackend(const std::string& backend) {
+    const std::string prefix = dir + "/" + backend + "-";
+
+    {
+        BufferedSink sink(prefix + "sink.json");
+        std::string expected = writeSink(sink);
+        sink.close();
+        check(sink.ok() && sink.bytesWritten() == expected.size(), backend + ": sink reported a failure");
+        check(readFile(prefix + "sink.json") == expected, backend + ": sink output differs");
+    }
+
+    {
+        // Filled on one thread and closed on another, like a streamed trace
+        AsyncFile file(prefix + "handoff.bin");
+        std::string expected;
+        std::thread writer([&] {
+            for (int i = 0; i < 64; ++i) {
+                std::string block(4096, static_cast<char>(i));
+                expected += block;
+                file.write(std::move(block));
+            }
+        });
+        writer.join();
+        check(file.close(), backend + ": handed-off file reported a failure");
+        check(readFile(prefix + "handoff.bin") == expected, backend + ": handed-off file differs");
+    }
+
+    {
+        std::string blob(5 << 20, '\0');
+        for (size_t i = 0; i < blob.size(); ++i)
+            blob[i] = static_cast<char>(i * 31 % 251);
+        std::string expected;
+        ArtifactWriter artifacts(true);
+        check(artifacts.backend() == backend, "backend() is " + std::string(artifacts.backend()) +
+                                                  ", expected " + backend);
+        artifacts.write(prefix + "blob.bin", blob);
+        artifacts.produce(prefix + "produced.json", [&](const std::string& path) {
+            BufferedSink sink(path);
+            expected = writeSink(sink);
+            sink.close();
+            return sink.ok();
+        });
+        artifacts.write(dir + "/missing/file.json", "{}");
+        check(!artifacts.wait() && artifacts.failures().size() == 1,
+              backend + ": expected exactly the write into a missing directory to fail");
+        check(readFile(prefix + "blob.bin") == blob, backend + ": blob differs");
+        check(readFile(prefix + "produced.json") == expected, backend + ": produced file differs");
+        check(!std::filesystem::exists(prefix + "blob.bin.tmp") &&
+                  !std::filesystem::exists(prefix + "produced.json.tmp"),
+              backend + ": a staging file was left behind");
+    }
+
+    {
+        // An atomic file replaces its target only once it is closed
+        const std::string target = prefix + "atomic.json";
+        std::ofstream(target) << "old";
+        {
+            AsyncFile abandoned(target, true);
+            abandoned.write(std::string(1 << 20, 'x'));
+        }
+        check(readFile(target) == "old", backend + ": an unclosed atomic file replaced its target");
+        AsyncFile replacement(target, true);
+        replacement.write(std::string("new"));
+        check(readFile(target) == "old", backend + ": an atomic file replaced its target before close()");
+        check(replacement.close() && readFile(target) == "new", backend + ": close() did not replace the target");
+        check(!std::filesystem::exists(target + ".tmp"), backend + ": the atomic staging file was left behind");
+    }
+
+    if (std::filesystem::exists("/dev/full")) {
+        // Every write fails with ENOSPC
+        AsyncFile full("/dev/full");
+        full.write(std::string(1 << 16, 'x'));
+        check(!full.close(), backend + ": a failed write was not reported");
+    }
+}
+
+} // namespace
+
+int main() {
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directory(dir);
+
+    if (ioUringAvailable())
+        testBackend("io_uring");
+    else
+        std::cout << "io_uring is not available here; testing the pwrite() path only\n";
+
+    setIoUringEnabled(false);
+    check(!ioUringAvailable(), "setIoUringEnabled(false) left io_uring enabled");
+    testBackend("threads");
+
+    std::filesystem::remove_all(dir);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,48 @@
+// Only variables get frame slots: string literals, char literals and
+// stream manipulators compile to constants.
+#include <algorithm>
+#include <iostream>
+#include "Bytecode.h"
+#include "Parser.h"
+#include "Tokenizer.h"
+#include "TraceGenerator.h"
+
+int main() {
+    int failures = 0;
+    allFunctions.clear();
+    Parser parser(tokenize("int main() {\n    int s = 2;\n    char c = 'x';\n    s = s + 3;\n"
+                           "    cout << \"Sum: \" << s << endl;\n    return 0;\n}\n").value);
+    if (!parser.parse().ok() || allFunctions.size() != 1) {
+        std::cerr << "parse failed\n";
+        return 1;
+    }
+
+    BytecodeProgram program = compileProgram(allFunctions);
+    std::vector<std::string> slots;
+    for (uint32_t nameId : program.functions[0].slotNames)
+        slots.push_back(program.names[nameId]);
+    std::sort(slots.begin(), slots.end());
+    if (slots != std::vector<std::string>{"c", "s"}) {
+        ++failures;
+        std::cerr << "slots:";
+        for (const auto& name : slots)
+            std::cerr << " " << name;
+        std::cerr << "\n";
+    }
+
+    // The program still runs as before: s ends up as 5
+    trace.clear();
+    std::unordered_map<std::string, int> vars;
+    simulateExecution(allFunctions[0], vars, ExecutionBudget());
+    bool assigned = false;
+    for (size_t i = 0; i < trace.retained(); ++i) {
+        const TraceEvent& event = trace[i];
+        if (event.action == TraceAction::Assign && trace.names[event.name] == "s")
+            assigned = event.value == 5;
+    }
+    if (!assigned) {
+        ++failures;
+        std::cerr << "s was not assigned 5\n";
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+// buildGrammar() on a small second language: its tables are built at
+// compile time, the shared parser parses and recovers with them, and a
+// malformed or ambiguous grammar is rejected.
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Grammar.h"
+#include "Parser.h"
+#include "Tokenizer.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (condition)
+        return;
+    ++failures;
+    std::cerr << what << "\n";
+}
+
+constexpr std::string_view keywords[] = {"let", "print"};
+constexpr std::string_view noWords[] = {""};
+
+constexpr std::string_view grammar = R"grammar(
+    Program -> Items => program
+    Items [function] -> ~ | * Item Items => prepend
+    Item -> 'let' IDENT "Expected name" '=' ANY ';' "Expected ;" => let
+          | 'print' IDENT ';' => print
+          | * "Unknown statement: $"
+)grammar";
+
+void program(ActionContext&, ParseValue* rhs, ParseValue& out) {
+    out.node = {"Program"};
+    for (auto it = rhs[0].list.rbegin(); it != rhs[0].list.rend(); ++it)
+        out.node.children.push_back(std::move(*it));
+}
+
+void prepend(ActionContext&, ParseValue* rhs, ParseValue& out) {
+    out.list = std::move(rhs[1].list);
+    out.list.push_back(std::move(rhs[0].node));
+}
+
+void let(ActionContext&, ParseValue* rhs, ParseValue& out) {
+    out.node = {"Let: " + rhs[1].token->value + " = " + rhs[3].token->value};
+}
+
+void print(ActionContext&, ParseValue* rhs, ParseValue& out) {
+    out.node = {"Print: " + rhs[1].token->value};
+}
+
+constexpr NamedAction actions[] = {
+    {"program", program},
+    {"prepend", prepend},
+    {"let", let},
+    {"print", print},
+};
+
+constexpr Grammar tables = buildGrammar(grammar, actions, {keywords, std::size(keywords)},
+                                        {noWords, 0}, {noWords, 0});
+
+// Item's nonterminal id and the production its table picks for `token`
+constexpr uint8_t itemEntry(std::string_view token) {
+    return tables.table[2][tables.literal(token)];
+}
+
+static_assert(tables.names[2] == "Item");
+static_assert(tables.productions[itemEntry("let")].symbols[0].id == tables.literal("let"));
+static_assert(tables.productions[itemEntry("print")].action == print);
+static_assert(itemEntry("x") == kErrorEntry);
+static_assert(!(tables.identifiers & terminalBit(tables.literal("let"))));
+
+void expectRejected(const char* name, std::string_view text) {
+    try {
+        buildGrammar(text, actions, {keywords, std::size(keywords)}, {noWords, 0}, {noWords, 0});
+    }
+    catch (const std::invalid_argument&) {
+        return;
+    }
+    ++failures;
+    std::cerr << name << ": grammar was accepted\n";
+}
+
+} // namespace
+
+int main() {
+    LanguageSpec spec = cppSubset;
+    spec.name = "let";
+    spec.keywords = {keywords, std::size(keywords)};
+    spec.grammar = &tables;
+
+    auto lexed = tokenize("let x = 1;\n"
+                          "let = 2;\n"
+                          "print x;\n"
+                          "x;\n"
+                          "print y;\n",
+                          spec);
+    Parser parser(lexed.value, spec);
+    auto parsed = parser.parse();
+
+    std::vector<std::string> labels;
+    for (const Node& child : parsed.value.children)
+        labels.push_back(child.label);
+    check(labels == std::vector<std::string>{"Let: x = 1", "Error: Expected name", "Print: x",
+                                             "Error: Unknown statement: x", "Print: y"},
+          "unexpected statements in the tree");
+    std::vector<std::string> messages;
+    for (const auto& d : parsed.diagnostics)
+        messages.push_back(std::to_string(d.line) + ":" + std::to_string(d.column) + ": " + d.message);
+    check(messages == std::vector<std::string>{"2:5: Expected name", "4:1: Unknown statement: x"},
+          "unexpected diagnostics");
+
+    expectRejected("conflict", "S -> 'a' | 'a' 'b' => let | * ~");
+    expectRejected("no default", "S -> 'a' | 'b'");
+    expectRejected("unknown action", "S -> 'a' 'b' => missing");
+    expectRejected("several values without an action", "S -> 'a' 'b'");
+    expectRejected("nonterminal without a rule", "S -> T");
+    expectRejected("message after a nonterminal", "S -> T \"oops\"\nT -> 'a'");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// Regression inputs for the error-recovering parser: each source has
+// several independent errors, and every one of them must be reported.
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Parser.h"
+#include "Tokenizer.h"
+
+namespace {
+
+int failures = 0;
+
+std::vector<std::string> diagnose(const std::string& code) {
+    auto lexed = tokenize(code);
+    Parser parser(lexed.value);
+    auto parsed = parser.parse();
+    std::vector<std::string> lines;
+    for (const auto& d : lexed.diagnostics)
+        lines.push_back(std::to_string(d.line) + ":" + std::to_string(d.column) + ": " + d.message);
+    for (const auto& d : parsed.diagnostics)
+        lines.push_back(std::to_string(d.line) + ":" + std::to_string(d.column) + ": " + d.message);
+    return lines;
+}
+
+void expect(const char* name, const std::string& code, const std::vector<std::string>& expected) {
+    std::vector<std::string> actual = diagnose(code);
+    if (actual == expected)
+        return;
+    ++failures;
+    std::cerr << name << ": expected\n";
+    for (const auto& line : expected)
+        std::cerr << "  " << line << "\n";
+    std::cerr << "got\n";
+    for (const auto& line : actual)
+        std::cerr << "  " << line << "\n";
+}
+
+} // namespace
+
+int main() {
+    // An unclosed '(' must not carry recovery past the ';' that ends its
+    // statement, nor into the next function
+    expect("unclosed paren",
+           "int main() {\n"
+           "    int x = 5\n"
+           "    x = (3;\n"
+           "    foo(1;\n"
+           "    return 0;\n"
+           "}\n"
+           "int g(int a {\n"
+           "    return a;\n"
+           "}\n",
+           {"3:5: Expected ; after variable declaration",
+            "4:10: Expected ) after function call arguments",
+            "7:13: Expected )"});
+
+    // A body left open ends at the next function header, which still parses
+    expect("unclosed body",
+           "int f() {\n"
+           "    if (1) {\n"
+           "        cout << 1;\n"
+           "int g() {\n"
+           "    cin 1;\n"
+           "    return 0;\n"
+           "}\n",
+           {"4:1: Expected } before function g",
+            "5:9: Expected >> after cin"});
+
+    // A bad statement's braces are skipped whole, then parsing resumes
+    expect("bad statement with body",
+           "int main() {\n"
+           "    while (1 {\n"
+           "        x = 1;\n"
+           "    }\n"
+           "    y = 2;\n"
+           "    cout 2;\n"
+           "}\n",
+           {"2:14: Expected ) after while condition",
+            "6:10: Expected << after cout"});
+
+    // An indented function definition inside a body is one bad statement
+    expect("nested function",
+           "int main() {\n"
+           "    int fact(int n) {\n"
+           "        return n;\n"
+           "    }\n"
+           "    cout 1;\n"
+           "    return 0;\n"
+           "}\n",
+           {"2:13: Expected ; after variable declaration",
+            "5:10: Expected << after cout"});
+
+    if (failures)
+        std::cerr << failures << " case(s) failed\n";
+    return failures ? 1 : 0;
+}
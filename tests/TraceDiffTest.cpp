@@ -0,0 +1,52 @@
+// trace-diff reports unreadable or malformed traces with exit status 2
+// instead of throwing, and compares readable ones.
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "TraceDiff.h"
+
+namespace {
+
+int failures = 0;
+const std::string dir = "trace_diff_test";
+
+std::string write(const std::string& name, const std::string& text) {
+    std::string path = dir + "/" + name;
+    std::ofstream(path) << text;
+    return path;
+}
+
+void expectStatus(const char* name, const std::string& first, const std::string& second, int expected) {
+    std::ostringstream out;
+    int status = runTraceDiff(first, second, out);
+    if (status == expected)
+        return;
+    ++failures;
+    std::cerr << name << ": expected " << expected << ", got " << status << "\n" << out.str();
+}
+
+} // namespace
+
+int main() {
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directory(dir);
+    std::string plain = write("plain.json", R"([{"action":"enter","node":1},{"action":"exit","node":1}])");
+    std::string folded = write("folded.json", R"([{"repeat":1,"events":[{"action":"enter","node":1},{"action":"exit","node":1}]}])");
+    write("chunk.json", R"([{"action":"enter","node":1},{"action":"exit","node":1}])");
+
+    expectStatus("identical", plain, folded, 0);
+    expectStatus("chunked", write("chunked.manifest.json", R"({"chunks":[{"file":"chunk.json"}]})"), plain, 0);
+    expectStatus("differs", plain, write("other.json", R"([{"action":"enter","node":2}])"), 1);
+
+    expectStatus("missing file", dir + "/absent.json", plain, 2);
+    expectStatus("not json", write("text.json", "not json"), plain, 2);
+    expectStatus("chunk without file", write("nofile.manifest.json", R"({"chunks":[{"first":0}]})"), plain, 2);
+    expectStatus("chunk file not a string", write("badfile.manifest.json", R"({"chunks":[{"file":3}]})"), plain, 2);
+    expectStatus("chunks not an array", write("badchunks.manifest.json", R"({"chunks":{"file":"chunk.json"}})"), plain, 2);
+    expectStatus("manifest as its own chunk", write("self.manifest.json", R"({"chunks":[{"file":"self.manifest.json"}]})"), plain, 2);
+    expectStatus("bad repeat", plain, write("badrepeat.json", R"([{"repeat":"x","events":[]}])"), 2);
+
+    std::filesystem::remove_all(dir);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,45 @@
+// Expanding a folded trace reproduces its events, and malformed blocks
+// read back from disk are reported instead of throwing.
+#include <iostream>
+#include "TraceFolding.h"
+
+namespace {
+
+int failures = 0;
+
+void expectExpands(const char* name, const char* folded, const char* expected) {
+    auto expanded = expandTrace(json::parse(folded));
+    if (expanded.ok() && expanded.value == json::parse(expected))
+        return;
+    ++failures;
+    std::cerr << name << ": expected " << expected << ", got "
+              << (expanded.ok() ? expanded.value.dump() : expanded.diagnostics.front().message) << "\n";
+}
+
+void expectRejected(const char* name, const char* folded) {
+    auto expanded = expandTrace(json::parse(folded));
+    if (!expanded.ok())
+        return;
+    ++failures;
+    std::cerr << name << ": expected an error, got " << expanded.value.dump() << "\n";
+}
+
+} // namespace
+
+int main() {
+    expectExpands("plain", R"([{"a":1},{"a":2}])", R"([{"a":1},{"a":2}])");
+    expectExpands("nested", R"([{"a":0},{"repeat":2,"events":[{"a":1},{"repeat":2,"events":[{"a":2}]}]}])",
+                  R"([{"a":0},{"a":1},{"a":2},{"a":2},{"a":1},{"a":2},{"a":2}])");
+    expectExpands("zero repeats", R"([{"repeat":0,"events":[{"a":1}]}])", "[]");
+
+    expectRejected("not an array", R"({"a":1})");
+    expectRejected("string repeat", R"([{"repeat":"x","events":[]}])");
+    expectRejected("negative repeat", R"([{"repeat":-1,"events":[]}])");
+    expectRejected("fractional repeat", R"([{"repeat":1.5,"events":[]}])");
+    expectRejected("huge repeat", R"([{"repeat":5000000000,"events":[]}])");
+    expectRejected("missing events", R"([{"repeat":2}])");
+    expectRejected("events not an array", R"([{"repeat":2,"events":{"a":1}}])");
+    expectRejected("event not an object", R"([1])");
+    expectRejected("nested bad block", R"([{"repeat":1,"events":[{"repeat":null,"events":[]}]}])");
+    return failures ? 1 : 0;
+}
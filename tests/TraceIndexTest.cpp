@@ -0,0 +1,107 @@
+// loadTraceIndex rejects malformed or inconsistent indexes, so
+// readTraceEvent never seeks outside what the index describes.
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include "TraceIndex.h"
+
+namespace {
+
+int failures = 0;
+const std::string dir = "trace_index_test";
+constexpr uint64_t kEvents = 150;
+
+// trace.json with kEvents events {"n": i}; returns the index TraceWriter
+// would write for it
+json writeTrace() {
+    std::ofstream out(dir + "/trace.json", std::ios::binary);
+    json offsets = json::array();
+    std::string text = "[";
+    for (uint64_t i = 0; i < kEvents; ++i) {
+        if (i)
+            text += ",";
+        if (i % TraceIndex::kStride == 0)
+            offsets.push_back(text.size());
+        text += "{\"n\":" + std::to_string(i) + "}";
+    }
+    out << text << "]";
+    return {{"events", kEvents}, {"stride", TraceIndex::kStride},
+            {"files", {{{"file", "trace.json"}, {"first", 0}, {"offset", 1}}}},
+            {"offsets", offsets}, {"functions", json::object()}, {"variables", json::object()}};
+}
+
+Result<TraceIndex> load(const json& index) {
+    std::ofstream(dir + "/trace.index.json") << index.dump();
+    return loadTraceIndex(dir + "/trace.index.json");
+}
+
+void expectRejected(const char* name, const json& index) {
+    if (!load(index).ok())
+        return;
+    ++failures;
+    std::cerr << name << ": expected the index to be rejected\n";
+}
+
+} // namespace
+
+int main() {
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directory(dir);
+    const json valid = writeTrace();
+
+    auto loaded = load(valid);
+    if (!loaded.ok()) {
+        ++failures;
+        std::cerr << "valid: " << loaded.diagnostics.front().message << "\n";
+    }
+    else {
+        for (uint64_t ordinal : {0, 1, 63, 64, 100, 128, 149}) {
+            auto event = readTraceEvent(loaded.value, ordinal, dir);
+            if (!event.ok() || event.value.value("n", uint64_t(-1)) != ordinal) {
+                ++failures;
+                std::cerr << "valid: wrong event " << ordinal << "\n";
+            }
+        }
+        if (readTraceEvent(loaded.value, kEvents, dir).ok()) {
+            ++failures;
+            std::cerr << "valid: read past the last event\n";
+        }
+    }
+
+    json index = valid;
+    index.erase("offsets");
+    expectRejected("missing offsets", index);
+    index = valid;
+    index["events"] = "many";
+    expectRejected("events not a number", index);
+    index = valid;
+    index["files"][0].erase("file");
+    expectRejected("file without a path", index);
+    index = valid;
+    index["functions"] = {{"main", "x"}};
+    expectRejected("bad function list", index);
+    index = valid;
+    index["offsets"].erase(2);
+    expectRejected("too few offsets", index);
+    index = valid;
+    index["offsets"][2] = 5;
+    expectRejected("offsets going backwards", index);
+    index = valid;
+    index["files"][0]["first"] = 10;
+    expectRejected("first file not at event 0", index);
+    index = valid;
+    index["files"].push_back({{"file", "trace.json"}, {"first", kEvents}, {"offset", 0}});
+    expectRejected("file past the last event", index);
+
+    // Without offsets for it, an event is read from the start of its file
+    TraceIndex partial = loaded.value;
+    partial.offsets.clear();
+    auto event = readTraceEvent(partial, 100, dir);
+    if (!event.ok() || event.value.value("n", uint64_t(-1)) != 100) {
+        ++failures;
+        std::cerr << "no offsets: wrong event\n";
+    }
+
+    std::filesystem::remove_all(dir);
+    return failures ? 1 : 0;
+}
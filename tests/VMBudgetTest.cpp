@@ -0,0 +1,85 @@
+// The step budget allows exactly --max-steps instructions, and loops that
+// update their counter with ++ / -- end without any budget.
+#include <iostream>
+#include "Parser.h"
+#include "Tokenizer.h"
+#include "TraceGenerator.h"
+#include "VM.h"
+
+namespace {
+
+int failures = 0;
+
+// A counting loop that runs 2 + 9 * iterations + 5 instructions, Halt
+// included, long enough to cross several deadline polls.
+BytecodeProgram countingLoop(uint32_t iterations) {
+    BytecodeProgram program;
+    program.functions.push_back({program.intern("count"), 0, 0, {program.intern("i")}});
+    program.code = {
+        {OpCode::PushConst, 0, 0, 0, kNoNode},
+        {OpCode::Store, 0, 0, 0, kNoNode},
+        {OpCode::Load, 0, 0, 0, kNoNode},           // 2: loop test
+        {OpCode::PushConst, 0, iterations, 0, kNoNode},
+        {OpCode::Lt, 0, 0, 0, kNoNode},
+        {OpCode::JumpIfFalse, 0, 11, 0, kNoNode},
+        {OpCode::Load, 0, 0, 0, kNoNode},
+        {OpCode::PushConst, 0, 1, 0, kNoNode},
+        {OpCode::Add, 0, 0, 0, kNoNode},
+        {OpCode::Store, 0, 0, 0, kNoNode},
+        {OpCode::Jump, 0, 2, 0, kNoNode},
+        {OpCode::Halt, 0, 0, 0, kNoNode}            // 11
+    };
+    return program;
+}
+
+void expect(const char* name, uint32_t iterations, uint64_t maxSteps, ExecutionStatus expected) {
+    BytecodeProgram program = countingLoop(iterations);
+    ExecutionBudget budget;
+    budget.maxSteps = maxSteps;
+    VariableStore vars;
+    ExecutionStatus status = VM(program, budget).run(0, vars);
+    if (status == expected)
+        return;
+    ++failures;
+    std::cerr << name << ": expected " << executionStatusName(expected) << ", got "
+              << executionStatusName(status) << "\n";
+}
+
+// Without a loop cap, a loop that never advanced would run into the step
+// limit instead of completing.
+void expectLoopEnds(const char* name, const std::string& code) {
+    allFunctions.clear();
+    Parser parser(tokenize(code).value);
+    auto parsed = parser.parse();
+    ExecutionBudget budget;
+    budget.maxSteps = 100000;
+    budget.maxLoopIterations = 0;
+    std::unordered_map<std::string, int> vars;
+    ExecutionStatus status = parsed.ok() && !allFunctions.empty()
+                                 ? simulateExecution(allFunctions[0], vars, budget)
+                                 : ExecutionStatus::StepLimit;
+    if (status == ExecutionStatus::Completed)
+        return;
+    ++failures;
+    std::cerr << name << ": loop did not complete (" << executionStatusName(status) << ")\n";
+}
+
+} // namespace
+
+int main() {
+    expect("halt only, exact", 0, 7, ExecutionStatus::Completed);
+    expect("halt only, one short", 0, 6, ExecutionStatus::StepLimit);
+    expect("one iteration, exact", 1, 16, ExecutionStatus::Completed);
+    expect("one iteration, one short", 1, 15, ExecutionStatus::StepLimit);
+    expect("past the poll interval, exact", 1000, 9007, ExecutionStatus::Completed);
+    expect("past the poll interval, one short", 1000, 9006, ExecutionStatus::StepLimit);
+    expect("unlimited", 1000, 0, ExecutionStatus::Completed);
+
+    expectLoopEnds("postfix increment", "int main() { for (int i = 0; i < 50; i++) { cout << i; } return 0; }");
+    expectLoopEnds("prefix decrement", "int main() { for (int i = 50; i > 0; --i) { cout << i; } return 0; }");
+    expectLoopEnds("statement increment", "int main() { int i = 0; while (i < 50) { ++i; } return 0; }");
+
+    if (failures)
+        std::cerr << failures << " case(s) failed\n";
+    return failures ? 1 : 0;
+}